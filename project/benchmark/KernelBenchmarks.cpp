@@ -0,0 +1,288 @@
+//External includes
+#include <benchmark/benchmark.h>
+
+//Standard includes
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+//Project includes
+#include "Camera.h"
+#include "Maths.h"
+#include "Texture.h"
+#include "Utils.h"
+
+using namespace dae;
+
+namespace
+{
+	// Same view and resolution the renderer uses, so the projected data matches a real frame
+	constexpr int g_Width = 640;
+	constexpr int g_Height = 480;
+
+	struct RasterTriangle
+	{
+		Vector2 v0{};
+		Vector2 v1{};
+		Vector2 v2{};
+		float invArea{};
+		Vector2 min{};
+		Vector2 max{};
+	};
+
+	// Loads vehicle.obj and its textures once and prepares the inputs every kernel runs over
+	struct BenchmarkData
+	{
+		static const BenchmarkData& Get()
+		{
+			static const BenchmarkData data{};
+			return data;
+		}
+
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		std::vector<uint32_t> vertexCounter{};
+		BoundingBox bounds{};
+		BoundingSphere boundingSphere{};
+
+		std::unique_ptr<Texture> upDiffuseTxt{};
+		std::unique_ptr<Texture> upNormalTxt{};
+
+		Camera camera{};
+		Matrix worldMatrix{};
+		Matrix worldViewProjectionMatrix{};
+
+		std::vector<Vector4> positions{};
+		std::vector<Vector3> unnormalizedNormals{};
+		std::vector<float> wDepths{};
+		std::vector<Vector3> weights{};
+		std::vector<RasterTriangle> rasterTriangles{};
+
+	private:
+		BenchmarkData()
+		{
+			if (!Utils::ParseOBJ("resources/vehicle.obj", vertices, indices, vertexCounter, bounds, boundingSphere))
+				throw std::runtime_error("Failed to load resources/vehicle.obj");
+
+			upDiffuseTxt.reset(Texture::LoadFromFile("resources/vehicle_diffuse.png"));
+			upNormalTxt.reset(Texture::LoadFromFile("resources/vehicle_normal.png"));
+
+			camera.Initialize(45.f, { 0.f, 5.f, -64.f }, float(g_Width) / g_Height, 0.1f, 100.f);
+			camera.CalculateViewMatrix();
+			worldMatrix = Matrix::CreateRotationY(0.5f);
+			worldViewProjectionMatrix = worldMatrix * camera.viewMatrix * camera.projectionMatrix;
+
+			// Positions and world space normals, the latter scaled so Normalized has real work to do
+			positions.reserve(vertices.size());
+			unnormalizedNormals.reserve(vertices.size());
+			for (const Vertex& vertex : vertices)
+			{
+				positions.emplace_back(vertex.position.ToPoint4());
+				unnormalizedNormals.emplace_back(worldMatrix.TransformVector(vertex.normal) * 3.7f);
+			}
+
+			// Random but reproducible barycentric weights that sum up to one
+			std::mt19937 generator{ 1337 };
+			std::uniform_real_distribution<float> distribution{ 0.f, 1.f };
+			weights.resize(1024);
+			for (Vector3& weight : weights)
+			{
+				weight = { distribution(generator), distribution(generator), distribution(generator) };
+				weight /= weight.x + weight.y + weight.z;
+			}
+
+			// Project the mesh the same way Renderer::ProjectInstances and Renderer::RasterizeVertex do
+			std::vector<Vector2> rasterPositions(vertices.size());
+			wDepths.resize(vertices.size());
+			for (size_t index{}; index < vertices.size(); ++index)
+			{
+				Vector4 projected = worldViewProjectionMatrix.TransformPoint(positions[index]);
+				wDepths[index] = projected.w;
+				projected.x /= projected.w;
+				projected.y /= projected.w;
+				rasterPositions[index] = { (1.f + projected.x) * 0.5f * g_Width, (1.f - projected.y) * 0.5f * g_Height };
+			}
+			for (size_t index{}; index + 2 < indices.size(); index += 3)
+			{
+				RasterTriangle triangle{};
+				triangle.v0 = rasterPositions[indices[index + 0]];
+				triangle.v1 = rasterPositions[indices[index + 1]];
+				triangle.v2 = rasterPositions[indices[index + 2]];
+
+				// Signed like in the renderer, the weights inside the triangle are positive for either facing
+				const float area = Vector2::Cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0);
+				if (std::abs(area) <= FLT_EPSILON) continue;
+				triangle.invArea = 1.f / area;
+
+				triangle.min = Vector2::Min(triangle.v0, Vector2::Min(triangle.v1, triangle.v2));
+				triangle.max = Vector2::Max(triangle.v0, Vector2::Max(triangle.v1, triangle.v2));
+				rasterTriangles.emplace_back(triangle);
+			}
+		}
+	};
+}
+
+#pragma region Matrix
+static void BM_MatrixMultiply(benchmark::State& state)
+{
+	const BenchmarkData& data = BenchmarkData::Get();
+
+	Matrix worldMatrix = data.worldMatrix;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(worldMatrix);
+		Matrix result = worldMatrix * data.camera.viewMatrix * data.camera.projectionMatrix;
+		benchmark::DoNotOptimize(result);
+	}
+	// Two matrix products per iteration
+	state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_MatrixMultiply);
+
+static void BM_MatrixTransformPoint(benchmark::State& state)
+{
+	const BenchmarkData& data = BenchmarkData::Get();
+
+	for (auto _ : state)
+	{
+		for (const Vector4& position : data.positions)
+		{
+			Vector4 transformed = data.worldViewProjectionMatrix.TransformPoint(position);
+			benchmark::DoNotOptimize(transformed);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * data.positions.size());
+	state.SetBytesProcessed(state.iterations() * data.positions.size() * sizeof(Vector4));
+}
+BENCHMARK(BM_MatrixTransformPoint);
+#pragma endregion
+
+#pragma region Vector
+static void BM_Vector3Normalized(benchmark::State& state)
+{
+	const BenchmarkData& data = BenchmarkData::Get();
+
+	for (auto _ : state)
+	{
+		for (const Vector3& normal : data.unnormalizedNormals)
+		{
+			Vector3 normalized = normal.Normalized();
+			benchmark::DoNotOptimize(normalized);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * data.unnormalizedNormals.size());
+	state.SetBytesProcessed(state.iterations() * data.unnormalizedNormals.size() * sizeof(Vector3));
+}
+BENCHMARK(BM_Vector3Normalized);
+#pragma endregion
+
+#pragma region Texture
+// Samples along the mesh' own UVs, which is the access pattern the pixel shader sees
+static void BM_TextureSample(benchmark::State& state)
+{
+	const BenchmarkData& data = BenchmarkData::Get();
+	const Texture* pTexture = state.range(0) == 0 ? data.upDiffuseTxt.get() : data.upNormalTxt.get();
+
+	for (auto _ : state)
+	{
+		for (const Vertex& vertex : data.vertices)
+		{
+			ColorRGB sample = pTexture->Sample(vertex.uv);
+			benchmark::DoNotOptimize(sample);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * data.vertices.size());
+	state.SetLabel(state.range(0) == 0 ? "vehicle_diffuse" : "vehicle_normal");
+}
+BENCHMARK(BM_TextureSample)->Arg(0)->Arg(1);
+
+// Samples a dense, screen-like grid of UVs, so neighbouring samples hit neighbouring texels
+static void BM_TextureSampleCoherent(benchmark::State& state)
+{
+	const BenchmarkData& data = BenchmarkData::Get();
+
+	const int samplesPerRow = 512;
+	const int rowCount = 64;
+	for (auto _ : state)
+	{
+		for (int row{}; row < rowCount; ++row)
+		{
+			for (int column{}; column < samplesPerRow; ++column)
+			{
+				ColorRGB sample = data.upDiffuseTxt->Sample({ float(column) / samplesPerRow, float(row) / rowCount });
+				benchmark::DoNotOptimize(sample);
+			}
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * samplesPerRow * rowCount);
+}
+BENCHMARK(BM_TextureSampleCoherent);
+#pragma endregion
+
+#pragma region Rasterization
+template<typename AttributeType>
+static void BM_InterpolateAttribute(benchmark::State& state, AttributeType Vertex::* pAttribute)
+{
+	const BenchmarkData& data = BenchmarkData::Get();
+
+	size_t triangleCount = data.indices.size() / 3;
+	for (auto _ : state)
+	{
+		for (size_t triangle{}; triangle < triangleCount; ++triangle)
+		{
+			const Vertex& vertex0 = data.vertices[data.indices[triangle * 3 + 0]];
+			const Vertex& vertex1 = data.vertices[data.indices[triangle * 3 + 1]];
+			const Vertex& vertex2 = data.vertices[data.indices[triangle * 3 + 2]];
+			const Vector3& weights = data.weights[triangle & (data.weights.size() - 1)];
+
+			// Use the view depths of the same triangle so the perspective correction is realistic
+			const float W0 = data.wDepths[data.indices[triangle * 3 + 0]];
+			const float W1 = data.wDepths[data.indices[triangle * 3 + 1]];
+			const float W2 = data.wDepths[data.indices[triangle * 3 + 2]];
+
+			const float wInterpolated = InterpolateDepth(W0, W1, W2, weights);
+			AttributeType interpolated = InterpolateAttribute(vertex0.*pAttribute, vertex1.*pAttribute, vertex2.*pAttribute,
+				W0, W1, W2, wInterpolated, weights);
+			benchmark::DoNotOptimize(interpolated);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * triangleCount);
+}
+BENCHMARK_CAPTURE(BM_InterpolateAttribute, uv, &Vertex::uv);
+BENCHMARK_CAPTURE(BM_InterpolateAttribute, normal, &Vertex::normal);
+BENCHMARK_CAPTURE(BM_InterpolateAttribute, color, &Vertex::color);
+
+// Walks every pixel center in the bounding box of every projected triangle, like the raster loop does
+static void BM_CalculateBarycentricCoordinates(benchmark::State& state)
+{
+	const BenchmarkData& data = BenchmarkData::Get();
+
+	int64_t pixelCount{};
+	int64_t coveredCount{};
+	for (auto _ : state)
+	{
+		pixelCount = 0;
+		coveredCount = 0;
+		for (const RasterTriangle& triangle : data.rasterTriangles)
+		{
+			for (int py{ int(triangle.min.y) }; py < int(std::ceil(triangle.max.y)); ++py)
+			{
+				for (int px{ int(triangle.min.x) }; px < int(std::ceil(triangle.max.x)); ++px)
+				{
+					Vector3 barycentric = CalculateBarycentricCoordinates(triangle.v0, triangle.v1, triangle.v2,
+						{ px + 0.5f, py + 0.5f }, triangle.invArea);
+					// The renderer already culls on facing in triangle setup, so like there only the coverage is tested
+					coveredCount += AreBarycentricValid(barycentric, false, false);
+					++pixelCount;
+				}
+			}
+		}
+		benchmark::DoNotOptimize(coveredCount);
+	}
+	state.SetItemsProcessed(state.iterations() * pixelCount);
+	state.counters["coverage"] = pixelCount ? double(coveredCount) / pixelCount : 0.0;
+}
+BENCHMARK(BM_CalculateBarycentricCoordinates);
+#pragma endregion
+
+BENCHMARK_MAIN();
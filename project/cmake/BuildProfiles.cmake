@@ -0,0 +1,144 @@
+# Optimized build profiles for the rasterizer targets
+#   RASTERIZER_ARCH     -march value for GCC/Clang (AVX, AVX2 or AVX512 for MSVC), empty for the compiler default
+#   RASTERIZER_LTO      Link time optimization for Release and RelWithDebInfo
+#   RASTERIZER_PGO      OFF, GENERATE (instrumented build) or USE (optimize with the profiles in RASTERIZER_PGO_DIR)
+
+set(RASTERIZER_ARCH "native" CACHE STRING "Target architecture for optimized builds")
+option(RASTERIZER_LTO "Enable link time optimization for optimized builds" ON)
+set(RASTERIZER_PGO "OFF" CACHE STRING "Profile guided optimization stage: OFF, GENERATE or USE")
+set_property(CACHE RASTERIZER_PGO PROPERTY STRINGS OFF GENERATE USE)
+set(RASTERIZER_PGO_DIR "${CMAKE_BINARY_DIR}/pgo-profiles" CACHE PATH "Folder the PGO profiles are written to and read from")
+set(RASTERIZER_PGO_TRAINING_FRAMES "120" CACHE STRING "Frames per benchmark scene when recording PGO profiles")
+set(RASTERIZER_PGO_MEASURE_FRAMES "300" CACHE STRING "Frames per benchmark scene when comparing the PGO and regular builds")
+
+if(NOT RASTERIZER_PGO MATCHES "^(OFF|GENERATE|USE)$")
+    message(FATAL_ERROR "RASTERIZER_PGO must be OFF, GENERATE or USE (got '${RASTERIZER_PGO}')")
+endif()
+
+if(RASTERIZER_LTO)
+    include(CheckIPOSupported)
+    check_ipo_supported(RESULT RASTERIZER_IPO_SUPPORTED OUTPUT RASTERIZER_IPO_ERROR LANGUAGES CXX)
+    if(NOT RASTERIZER_IPO_SUPPORTED)
+        message(STATUS "Link time optimization not supported: ${RASTERIZER_IPO_ERROR}")
+    endif()
+endif()
+
+# Clang writes raw profiles that first need to be merged into one .profdata file
+if(RASTERIZER_PGO STREQUAL "USE" AND CMAKE_CXX_COMPILER_ID MATCHES "Clang" AND NOT MSVC)
+    set(RASTERIZER_PGO_PROFDATA "${RASTERIZER_PGO_DIR}/rasterizer.profdata")
+    file(GLOB RASTERIZER_PGO_RAW_FILES "${RASTERIZER_PGO_DIR}/*.profraw")
+    if(RASTERIZER_PGO_RAW_FILES)
+        string(REGEX MATCH "^[0-9]+" RASTERIZER_CLANG_MAJOR "${CMAKE_CXX_COMPILER_VERSION}")
+        get_filename_component(RASTERIZER_COMPILER_DIR "${CMAKE_CXX_COMPILER}" DIRECTORY)
+        find_program(LLVM_PROFDATA NAMES llvm-profdata llvm-profdata-${RASTERIZER_CLANG_MAJOR}
+            HINTS "${RASTERIZER_COMPILER_DIR}")
+        if(NOT LLVM_PROFDATA)
+            message(FATAL_ERROR "llvm-profdata is needed to merge the PGO profiles in ${RASTERIZER_PGO_DIR}")
+        endif()
+        execute_process(
+            COMMAND ${LLVM_PROFDATA} merge -output=${RASTERIZER_PGO_PROFDATA} ${RASTERIZER_PGO_RAW_FILES}
+            RESULT_VARIABLE RASTERIZER_PGO_MERGE_RESULT)
+        if(NOT RASTERIZER_PGO_MERGE_RESULT EQUAL 0)
+            message(FATAL_ERROR "Merging the PGO profiles failed")
+        endif()
+    endif()
+endif()
+
+function(rasterizer_apply_build_profile target)
+    set(optimized "$<CONFIG:Release,RelWithDebInfo>")
+
+    # Optimization level and instruction set
+    if(MSVC)
+        target_compile_options(${target} PRIVATE $<${optimized}:/O2 /Ob2 /Oi /Gy>)
+        if(RASTERIZER_ARCH MATCHES "^(AVX|AVX2|AVX512)$")
+            target_compile_options(${target} PRIVATE $<${optimized}:/arch:${RASTERIZER_ARCH}>)
+        endif()
+    else()
+        target_compile_options(${target} PRIVATE $<${optimized}:-O3>)
+        if(RASTERIZER_ARCH)
+            target_compile_options(${target} PRIVATE $<${optimized}:-march=${RASTERIZER_ARCH}>)
+        endif()
+    endif()
+
+    # Link time optimization
+    if(RASTERIZER_LTO AND RASTERIZER_IPO_SUPPORTED)
+        set_property(TARGET ${target} PROPERTY INTERPROCEDURAL_OPTIMIZATION_RELEASE TRUE)
+        set_property(TARGET ${target} PROPERTY INTERPROCEDURAL_OPTIMIZATION_RELWITHDEBINFO TRUE)
+    endif()
+
+    # Profile guided optimization
+    if(RASTERIZER_PGO STREQUAL "GENERATE")
+        file(MAKE_DIRECTORY ${RASTERIZER_PGO_DIR})
+        if(MSVC)
+            target_compile_options(${target} PRIVATE /GL)
+            target_link_options(${target} PRIVATE /LTCG /GENPROFILE:PGD=${RASTERIZER_PGO_DIR}/${target}.pgd)
+        elseif(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+            # The vertex stage runs on several threads, so the counters have to be updated atomically
+            target_compile_options(${target} PRIVATE -fprofile-generate=${RASTERIZER_PGO_DIR} -fprofile-update=atomic)
+            target_link_options(${target} PRIVATE -fprofile-generate=${RASTERIZER_PGO_DIR})
+        else()
+            target_compile_options(${target} PRIVATE -fprofile-generate=${RASTERIZER_PGO_DIR})
+            target_link_options(${target} PRIVATE -fprofile-generate=${RASTERIZER_PGO_DIR})
+        endif()
+    elseif(RASTERIZER_PGO STREQUAL "USE")
+        if(MSVC)
+            target_compile_options(${target} PRIVATE /GL)
+            target_link_options(${target} PRIVATE /LTCG /USEPROFILE:PGD=${RASTERIZER_PGO_DIR}/${target}.pgd)
+        elseif(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+            # Code the training run never reached is still optimized normally instead of for size
+            target_compile_options(${target} PRIVATE -fprofile-use=${RASTERIZER_PGO_DIR} -fprofile-correction
+                -fprofile-partial-training -Wno-missing-profile)
+            target_link_options(${target} PRIVATE -fprofile-use=${RASTERIZER_PGO_DIR})
+        else()
+            target_compile_options(${target} PRIVATE -fprofile-use=${RASTERIZER_PGO_PROFDATA} -Wno-profile-instr-unprofiled)
+            target_link_options(${target} PRIVATE -fprofile-use=${RASTERIZER_PGO_PROFDATA})
+        endif()
+    endif()
+endfunction()
+
+# Runs the benchmark scenes headless on the instrumented rasterizer to record the profiles used by RASTERIZER_PGO=USE
+function(rasterizer_add_pgo_training target)
+    if(NOT RASTERIZER_PGO STREQUAL "GENERATE")
+        return()
+    endif()
+
+    add_custom_target(pgo-train
+        COMMAND $<TARGET_FILE:${target}> --headless --scenes ${RASTERIZER_PGO_TRAINING_FRAMES}
+        WORKING_DIRECTORY ${CMAKE_CURRENT_BINARY_DIR}
+        DEPENDS ${target}
+        COMMENT "Recording PGO profiles into ${RASTERIZER_PGO_DIR}"
+        VERBATIM)
+endfunction()
+
+# Adds the 'pgo' target to a regular build tree: builds an instrumented rasterizer, trains it on the benchmark scenes,
+# rebuilds it with the recorded profiles and reports the gain against a build without PGO (see PGOWorkflow.cmake)
+function(rasterizer_add_pgo_workflow target)
+    if(NOT RASTERIZER_PGO STREQUAL "OFF")
+        return()
+    endif()
+
+    if(CMAKE_CONFIGURATION_TYPES)
+        set(build_type Release)
+    else()
+        set(build_type ${CMAKE_BUILD_TYPE})
+    endif()
+    # Lists can't be passed through the command line as is
+    string(REPLACE ";" "|" prefix_path "${CMAKE_PREFIX_PATH}")
+
+    add_custom_target(pgo
+        COMMAND ${CMAKE_COMMAND}
+            -DSOURCE_DIR=${CMAKE_SOURCE_DIR}
+            -DWORK_DIR=${CMAKE_BINARY_DIR}/pgo-workflow
+            -DTARGET=${target}
+            -DGENERATOR=${CMAKE_GENERATOR}
+            -DBUILD_TYPE=${build_type}
+            -DCXX_COMPILER=${CMAKE_CXX_COMPILER}
+            -DPREFIX_PATH=${prefix_path}
+            -DARCH=${RASTERIZER_ARCH}
+            -DLTO=${RASTERIZER_LTO}
+            -DTRAINING_FRAMES=${RASTERIZER_PGO_TRAINING_FRAMES}
+            -DMEASURE_FRAMES=${RASTERIZER_PGO_MEASURE_FRAMES}
+            -P ${CMAKE_CURRENT_FUNCTION_LIST_DIR}/PGOWorkflow.cmake
+        USES_TERMINAL
+        VERBATIM)
+endfunction()
@@ -0,0 +1,138 @@
+# Profile guided optimization workflow, run by the 'pgo' target in script mode (cmake -P)
+#   1. Build the rasterizer without PGO, as the baseline
+#   2. Build an instrumented rasterizer and record profiles by running the benchmark scenes headless
+#   3. Rebuild the instrumented tree with the recorded profiles
+#   4. Run the benchmark scenes on the baseline and the PGO build and report the gain
+
+foreach(variable SOURCE_DIR WORK_DIR TARGET GENERATOR BUILD_TYPE)
+    if(NOT DEFINED ${variable})
+        message(FATAL_ERROR "PGOWorkflow.cmake: ${variable} is not set")
+    endif()
+endforeach()
+
+string(REPLACE "|" ";" PREFIX_PATH "${PREFIX_PATH}")
+set(BASELINE_DIR "${WORK_DIR}/baseline")
+set(PGO_BUILD_DIR "${WORK_DIR}/pgo")
+set(PROFILE_DIR "${WORK_DIR}/profiles")
+set(REPORT_FILE "${WORK_DIR}/pgo-report.txt")
+
+function(run_step description)
+    message(STATUS "[PGO] ${description}")
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "[PGO] ${description} failed (${result})")
+    endif()
+endfunction()
+
+function(configure_and_build build_dir pgo_stage)
+    run_step("Configuring ${build_dir} (RASTERIZER_PGO=${pgo_stage})"
+        ${CMAKE_COMMAND} -S ${SOURCE_DIR} -B ${build_dir} -G ${GENERATOR}
+            -DCMAKE_BUILD_TYPE=${BUILD_TYPE}
+            -DCMAKE_CXX_COMPILER=${CXX_COMPILER}
+            "-DCMAKE_PREFIX_PATH=${PREFIX_PATH}"
+            "-DRASTERIZER_ARCH=${ARCH}"
+            -DRASTERIZER_LTO=${LTO}
+            -DRASTERIZER_PGO=${pgo_stage}
+            -DRASTERIZER_PGO_DIR=${PROFILE_DIR})
+    run_step("Building ${build_dir}"
+        ${CMAKE_COMMAND} --build ${build_dir} --config ${BUILD_TYPE} --target ${TARGET} --parallel)
+endfunction()
+
+# Runs the benchmark scenes and stores the average frame time per scene in <out_prefix>_<scene> and the names in <out_prefix>_SCENES
+function(measure build_dir frames out_prefix)
+    file(GLOB_RECURSE executables "${build_dir}/project/${TARGET}" "${build_dir}/project/${TARGET}.exe"
+        "${build_dir}/project/*/${TARGET}" "${build_dir}/project/*/${TARGET}.exe")
+    list(GET executables 0 executable)
+
+    message(STATUS "[PGO] Running the benchmark scenes on ${executable}")
+    execute_process(
+        COMMAND ${executable} --headless --scenes ${frames}
+        WORKING_DIRECTORY ${build_dir}/project
+        OUTPUT_VARIABLE output
+        RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "[PGO] Benchmark scenes failed (${result}):\n${output}")
+    endif()
+
+    set(scenes)
+    string(REGEX MATCHALL "SCENE [A-Za-z]+ [0-9.e+-]+ ms" lines "${output}")
+    foreach(line ${lines})
+        string(REGEX REPLACE "SCENE ([A-Za-z]+) ([0-9.e+-]+) ms" "\\1;\\2" fields "${line}")
+        list(GET fields 0 scene)
+        list(GET fields 1 milliseconds)
+        list(APPEND scenes ${scene})
+        set(${out_prefix}_${scene} ${milliseconds} PARENT_SCOPE)
+    endforeach()
+    set(${out_prefix}_SCENES ${scenes} PARENT_SCOPE)
+endfunction()
+
+# 1. Baseline
+configure_and_build(${BASELINE_DIR} OFF)
+
+# 2. Instrumented build and training, stale profiles of an earlier run would skew the new ones
+file(REMOVE_RECURSE ${PROFILE_DIR})
+configure_and_build(${PGO_BUILD_DIR} GENERATE)
+measure(${PGO_BUILD_DIR} ${TRAINING_FRAMES} TRAINING)
+
+# 3. Optimized build, in the same tree so GCC finds the profiles of every object file
+configure_and_build(${PGO_BUILD_DIR} USE)
+
+# 4. Report
+measure(${BASELINE_DIR} ${MEASURE_FRAMES} BASELINE)
+measure(${PGO_BUILD_DIR} ${MEASURE_FRAMES} PGO)
+
+# Scene times are printed with three decimals, so dropping the dot gives whole microseconds for CMake's integer math
+function(to_microseconds milliseconds out)
+    string(REPLACE "." "" microseconds "${milliseconds}")
+    string(REGEX REPLACE "^0+" "" microseconds "${microseconds}")
+    if(microseconds STREQUAL "")
+        set(microseconds 0)
+    endif()
+    set(${out} ${microseconds} PARENT_SCOPE)
+endfunction()
+
+function(pad text width out)
+    string(LENGTH "${text}" length)
+    while(length LESS width)
+        string(APPEND text " ")
+        math(EXPR length "${length} + 1")
+    endwhile()
+    set(${out} "${text}" PARENT_SCOPE)
+endfunction()
+
+pad("Scene" 16 report)
+pad("Baseline (ms)" 16 column)
+string(APPEND report "${column}")
+pad("PGO (ms)" 16 column)
+string(APPEND report "${column}Gain\n")
+foreach(scene ${BASELINE_SCENES})
+    if(NOT DEFINED PGO_${scene})
+        continue()
+    endif()
+    to_microseconds(${BASELINE_${scene}} baseline)
+    to_microseconds(${PGO_${scene}} optimized)
+
+    # Frame time saved, in tenths of a percent of the baseline
+    set(gain "n/a")
+    if(baseline GREATER 0)
+        math(EXPR permille "(${baseline} - ${optimized}) * 1000 / ${baseline}")
+        math(EXPR whole "${permille} / 10")
+        math(EXPR tenth "${permille} % 10")
+        if(tenth LESS 0)
+            math(EXPR tenth "-${tenth}")
+            if(whole EQUAL 0)
+                set(whole "-0")
+            endif()
+        endif()
+        set(gain "${whole}.${tenth}%")
+    endif()
+
+    pad("${scene}" 16 line)
+    pad("${BASELINE_${scene}}" 16 column)
+    string(APPEND line "${column}")
+    pad("${PGO_${scene}}" 16 column)
+    string(APPEND report "${line}${column}${gain}\n")
+endforeach()
+
+file(WRITE ${REPORT_FILE} "${report}")
+message(STATUS "[PGO] Average frame time per scene, also written to ${REPORT_FILE}\n${report}")
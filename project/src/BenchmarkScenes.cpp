@@ -0,0 +1,120 @@
+#include "BenchmarkScenes.h"
+#include "Renderer.h"
+#include "Utils.h"
+
+namespace dae
+{
+	namespace
+	{
+		// Quad facing the camera, flagged as occluder. Split into a grid, triangles with a vertex outside the screen aren't drawn
+		void AddOccluderWall(Renderer& renderer, const Vector3& center, float width, float height)
+		{
+			constexpr int columns{ 16 };
+			constexpr int rows{ 12 };
+
+			Mesh wall{};
+			MeshLod& lod = wall.lods[0];
+			const Vector3 topLeft{ center.x - width * 0.5f, center.y + height * 0.5f, center.z };
+			for (int row{}; row <= rows; ++row)
+			{
+				for (int column{}; column <= columns; ++column)
+				{
+					const Vector2 uv{ float(column) / columns, float(row) / rows };
+					const Vector3 position{ topLeft.x + uv.x * width, topLeft.y - uv.y * height, topLeft.z };
+					wall.vertices.emplace_back(Vertex{ position, colors::White, uv, { 0.f, 0.f, -1.f }, { 1.f, 0.f, 0.f } });
+					lod.vertexCounter.emplace_back(uint32_t(lod.vertexCounter.size()));
+				}
+			}
+			for (int row{}; row < rows; ++row)
+			{
+				for (int column{}; column < columns; ++column)
+				{
+					const uint32_t index0 = row * (columns + 1) + column;
+					const uint32_t index2 = index0 + columns + 1;
+					lod.indices.insert(lod.indices.end(), { index0, index0 + 1, index2, index2, index0 + 1, index2 + 1 });
+				}
+			}
+			lod.primitiveTopology = PrimitiveTopology::TriangleList;
+			wall.bounds = CalculateBoundingBox(wall.vertices);
+			wall.boundingSphere = CalculateBoundingSphere(wall.bounds, wall.vertices);
+			wall.isOccluder = true;
+			renderer.AddMeshInstances(renderer.AddMesh(std::move(wall)), { Matrix{} });
+		}
+	}
+
+	const std::vector<BenchmarkScene>& GetBenchmarkScenes()
+	{
+		static const std::vector<BenchmarkScene> scenes
+		{
+			{ "Combined",		[](Renderer&) {} },
+			{ "ObservedArea",	[](Renderer& renderer) { renderer.CycleShadingMode(); } },
+			{ "Diffuse",		[](Renderer& renderer) { renderer.CycleShadingMode(); renderer.CycleShadingMode(); } },
+			{ "Specular",		[](Renderer& renderer) { for (int i{}; i < 3; ++i) renderer.CycleShadingMode(); } },
+			{ "NoNormalMap",	[](Renderer& renderer) { renderer.ToggleNormalMap(); } },
+			{ "DepthBuffer",	[](Renderer& renderer) { renderer.ToggleDepthBufferVisualization(); } },
+			{ "WireFrames",		[](Renderer& renderer) { renderer.ToggleWireFrames(); } },
+			// Close enough that the vehicle fills the screen, large triangles and lots of overdraw
+			{ "CloseUp",		[](Renderer& renderer) { renderer.GetCamera().origin = { 0.f, 3.f, -24.f }; } },
+			{ "Deferred",		[](Renderer& renderer) { renderer.CycleRenderPath(); } },
+			{ "DeferredCloseUp",[](Renderer& renderer) { renderer.CycleRenderPath(); renderer.GetCamera().origin = { 0.f, 3.f, -24.f }; } },
+			{ "VisibilityBuffer",[](Renderer& renderer) { renderer.CycleRenderPath(); renderer.CycleRenderPath(); } },
+			{ "VisibilityCloseUp",[](Renderer& renderer) { renderer.CycleRenderPath(); renderer.CycleRenderPath(); renderer.GetCamera().origin = { 0.f, 3.f, -24.f }; } },
+			{ "DepthPrePass",	[](Renderer& renderer) { for (int i{}; i < 3; ++i) renderer.CycleRenderPath(); } },
+			{ "DepthPrePassCloseUp",[](Renderer& renderer) { for (int i{}; i < 3; ++i) renderer.CycleRenderPath(); renderer.GetCamera().origin = { 0.f, 3.f, -24.f }; } },
+			{ "Sorted",			[](Renderer& renderer) { renderer.ToggleDepthSorting(); } },
+			{ "SortedCloseUp",	[](Renderer& renderer) { renderer.ToggleDepthSorting(); renderer.GetCamera().origin = { 0.f, 3.f, -24.f }; } },
+			{ "NoHiZ",			[](Renderer& renderer) { renderer.ToggleHiZ(); } },
+			{ "NoHiZCloseUp",	[](Renderer& renderer) { renderer.ToggleHiZ(); renderer.GetCamera().origin = { 0.f, 3.f, -24.f }; } },
+			// A wall between the camera and the vehicle, the vehicle never reaches the vertex stage
+			{ "Occluded",		[](Renderer& renderer) { AddOccluderWall(renderer, { 0.f, 5.f, -30.f }, 80.f, 60.f); } },
+			{ "NoOcclusionCulling",[](Renderer& renderer) { AddOccluderWall(renderer, { 0.f, 5.f, -30.f }, 80.f, 60.f); renderer.ToggleOcclusionCulling(); } },
+			// Camera turned away from the vehicle, nothing should reach the vertex stage
+			{ "OffScreen",		[](Renderer& renderer) { renderer.GetCamera().origin = { 200.f, 5.f, -64.f }; } },
+			{ "NoFrustumCulling",[](Renderer& renderer) { renderer.ToggleFrustumCulling(); renderer.GetCamera().origin = { 200.f, 5.f, -64.f }; } },
+			{ "NoMeshletCulling",[](Renderer& renderer) { renderer.ToggleMeshletCulling(); } },
+			{ "NoMeshletCullingCloseUp",[](Renderer& renderer) { renderer.ToggleMeshletCulling(); renderer.GetCamera().origin = { 0.f, 3.f, -24.f }; } },
+			// Closed mesh, the back faces all end up behind the front ones
+			{ "NoBackfaceCulling",[](Renderer& renderer) { renderer.GetMeshes()[0]->cullMode = CullMode::None; } },
+			// Far enough that most triangles cover a single pixel or none at all, the vehicle switches to a coarser level of detail
+			{ "FarAway",		[](Renderer& renderer)
+				{
+					Camera& camera = renderer.GetCamera();
+					camera.far = 1000.f;
+					camera.CalculateProjectionMatrix();
+					camera.origin = { 0.f, 5.f, -640.f };
+				} },
+			{ "NoLods",			[](Renderer& renderer)
+				{
+					renderer.ToggleLods();
+					Camera& camera = renderer.GetCamera();
+					camera.far = 1000.f;
+					camera.CalculateProjectionMatrix();
+					camera.origin = { 0.f, 5.f, -640.f };
+				} },
+			// A grid of vehicles sharing one mesh, the near rows hide part of the far ones and those switch to coarser levels
+			{ "Instanced",		[](Renderer&) {}, "resources/instanced.scene" },
+			// Thousands of static instances of which only a handful is in view, culling should not cost more than drawing those
+			{ "ManyInstances",	[](Renderer& renderer)
+				{
+					std::vector<Matrix> worldMatrices{};
+					for (int row{}; row < 48; ++row)
+					{
+						for (int column{}; column < 48; ++column)
+							worldMatrices.emplace_back(Matrix::CreateTranslation(float(column - 24) * 100.f, 0.f, float(row + 1) * 100.f));
+					}
+					renderer.AddMeshInstances(0, worldMatrices);
+					Camera& camera = renderer.GetCamera();
+					camera.far = 300.f;
+					camera.CalculateProjectionMatrix();
+				} },
+			// Front and back end of every frame one after the other, what pipelining gains
+			{ "NoPipelining",	[](Renderer& renderer) { renderer.TogglePipelinedFrames(); } },
+			// Float colors resolved in bands after the raster pass, and row by row during shading in the visibility buffer path
+			{ "Hdr",			[](Renderer& renderer) { renderer.ToggleHdr(); } },
+			{ "HdrVisibilityBuffer",[](Renderer& renderer) { renderer.ToggleHdr(); renderer.CycleRenderPath(); renderer.CycleRenderPath(); } },
+			// One OBJ behind two scene meshes with their own material and cull mode, each has to keep its own
+			{ "Materials",		[](Renderer&) {}, "resources/materials.scene" },
+		};
+		return scenes;
+	}
+}
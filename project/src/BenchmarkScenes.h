@@ -0,0 +1,20 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	class Renderer;
+
+	// A scripted workload for the benchmark mode, applied to a freshly created Renderer
+	struct BenchmarkScene
+	{
+		std::string name;
+		std::function<void(Renderer&)> setup;
+		std::string sceneFile{}; // Loaded by the renderer before setup, empty for its default scene
+	};
+
+	// Covers every shading mode and visualization, so PGO training sees all hot paths
+	const std::vector<BenchmarkScene>& GetBenchmarkScenes();
+}
@@ -108,7 +108,7 @@ namespace dae
 			return *this;
 		}
 
-		const ColorRGB& operator/(float s) const
+		ColorRGB operator/(float s) const
 		{
 			const float invScale{ 1.f / s };
 			return { r * invScale, g * invScale, b * invScale };
@@ -1,6 +1,8 @@
 #pragma once
 #include "Maths.h"
+#include "ResourceManager.h"
 #include "Texture.h"
+#include <memory>
 #include <vector>
 
 namespace dae
@@ -25,40 +27,96 @@ namespace dae
 		Vector3 viewDirection{};
 	};
 
+	// Object space, axis aligned
+	struct BoundingBox
+	{
+		Vector3 min{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	};
+
+	// Object space, centered on the bounding box
+	struct BoundingSphere
+	{
+		Vector3 center{};
+		float radius{};
+	};
+
+	// Consecutive triangles of a mesh that share few vertices, culled as a whole before any vertex is transformed
+	struct Meshlet
+	{
+		static constexpr uint32_t MaxVertices{ 64 };
+		static constexpr uint32_t MaxTriangles{ 124 };
+
+		uint32_t firstTriangle{};
+		uint32_t triangleCount{};
+		uint32_t firstVertex{}; // Into Mesh::meshletVertices
+		uint32_t vertexCount{};
+
+		BoundingBox bounds{};
+		BoundingSphere boundingSphere{};
+		// Every face normal lies within the cone around the axis, a cutoff of 1 means it can't be backface culled
+		Vector3 coneAxis{};
+		float coneCutoff{ 1.f };
+	};
+
+	// World space planes (normal, distance), a point is inside when it is on the positive side of all of them
+	struct Frustum
+	{
+		Vector4 planes[6]{};
+	};
+
 	enum class PrimitiveTopology
 	{
 		TriangleList,
 		TriangleStrip
 	};
 
-	struct Mesh
+	// Which side of the triangles is rejected in triangle setup, the front faces are clockwise on screen
+	enum class CullMode
 	{
-		inline void LoadDiffuseTexture(const std::string& path)		{ m_upDiffuseTxt.reset(Texture::LoadFromFile(path)); }
-		inline void LoadNormalMap(const std::string& path)			{ m_upNormalTxt.reset(Texture::LoadFromFile(path)); }
-		inline void LoadGlossinessMap(const std::string& path)		{ m_upGlossTxt.reset(Texture::LoadFromFile(path)); }
-		inline void LoadSpecularMap(const std::string& path)		{ m_upSpecularTxt.reset(Texture::LoadFromFile(path)); }
+		Back,
+		Front,
+		None
+	};
 
-		inline ColorRGB SampleDiffuse(const Vector2& interpUV)
+	// The triangles of one level of detail, level 0 is the full mesh. Every level indexes the same vertices, see Utils::BuildLods
+	struct MeshLod
+	{
+		std::vector<uint32_t> indices{};
+		PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleStrip };
+		std::vector<uint32_t> vertexCounter{}; // Only the vertices its indices use
+
+		// Built once by BuildMeshlets
+		std::vector<Meshlet> meshlets{};
+		std::vector<uint32_t> meshletVertices{};
+
+		// Simplification error relative to the bounding sphere radius
+		float error{};
+	};
+
+	struct Mesh
+	{
+		inline ColorRGB SampleDiffuse(const Vector2& interpUV) const
 		{
-			if (m_upDiffuseTxt == nullptr) return {};
+			if (m_pDiffuseTxt == nullptr) return {};
 
-			return m_upDiffuseTxt->Sample(interpUV);
+			return m_pDiffuseTxt->Sample(interpUV);
 		}
-		inline ColorRGB SamplePhong(const Vector3& dirToLight, const Vector3& viewDir, const Vector3& interpNormal, const Vector2& interpUV, float shininess)
+		inline ColorRGB SamplePhong(const Vector3& dirToLight, const Vector3& viewDir, const Vector3& interpNormal, const Vector2& interpUV, float shininess) const
 		{
-			if (m_upSpecularTxt == nullptr) return {};
-			if (m_upGlossTxt == nullptr) return {};
+			if (m_pSpecularTxt == nullptr) return {};
+			if (m_pGlossTxt == nullptr) return {};
 
-			float ks = m_upSpecularTxt->Sample(interpUV).r;
-			float exp = m_upGlossTxt->Sample(interpUV).r * shininess;
+			float ks = m_pSpecularTxt->Sample(interpUV).r;
+			float exp = m_pGlossTxt->Sample(interpUV).r * shininess;
 
 			Vector3 reflect{ dirToLight - 2 * Vector3::Dot(interpNormal, dirToLight) * interpNormal };
 			float cosAlpha{ std::max(Vector3::Dot(reflect, viewDir), 0.f) };
 			return ColorRGB(1, 1, 1) * ks * std::pow(cosAlpha, exp);
 		}
-		inline Vector3 SampleNormalMap(const Vector3& interpNormal, const Vector3& interpTangent, const Vector2& interpUV)
+		inline Vector3 SampleNormalMap(const Vector3& interpNormal, const Vector3& interpTangent, const Vector2& interpUV) const
 		{
-			if (m_upNormalTxt == nullptr) return {};
+			if (m_pNormalTxt == nullptr) return {};
 
 			// Calculate the tangent space matrix
 			Vector3 binormal = Vector3::Cross(interpNormal, interpTangent);
@@ -70,7 +128,7 @@ namespace dae
 			);
 
 			// Sample the normal map
-			ColorRGB nrmlMap = m_upNormalTxt->Sample(interpUV);
+			ColorRGB nrmlMap = m_pNormalTxt->Sample(interpUV);
 			Vector3 normal{ nrmlMap.r, nrmlMap.g, nrmlMap.b };
 			normal = 2.f * normal - Vector3(1.f, 1.f, 1.f);
 			normal = tangentSpaceAxis.TransformVector(normal);
@@ -78,21 +136,41 @@ namespace dae
 			return normal.Normalized();
 		}
 
+		// Shared by every instance of the mesh
 		std::vector<Vertex> vertices{};
-		std::vector<uint32_t> indices{};
-		PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleStrip };
+		// Level 0 is the full mesh, every level after that has about half the triangles
+		std::vector<MeshLod> lods = std::vector<MeshLod>(1);
+		CullMode cullMode{ CullMode::Back };
+
+		BoundingBox bounds{};
+		BoundingSphere boundingSphere{};
+		bool isOccluder{ false }; // Hides the meshes behind it, see Renderer::CullInstances
+
+		// Textures, from the ResourceManager
+		TextureHandle m_pDiffuseTxt;
+		TextureHandle m_pNormalTxt;
+		TextureHandle m_pGlossTxt;
+		TextureHandle m_pSpecularTxt;
+	};
 
-		std::vector<Vertex_Out> vertices_out{};
+	// One draw of a shared mesh, it only adds a transform and a tint. The rest is what the pipeline produced for it this frame,
+	// kept per instance so the passes that run after the raster pass still find it
+	struct MeshInstance
+	{
+		uint32_t mesh{}; // Index into the renderer's meshes
 		Matrix worldMatrix{};
-
-		// Textures
-		std::unique_ptr<Texture> m_upDiffuseTxt;
-		std::unique_ptr<Texture> m_upNormalTxt;
-		std::unique_ptr<Texture> m_upGlossTxt;
-		std::unique_ptr<Texture> m_upSpecularTxt;
-
+		ColorRGB tint{ colors::White };
 
 		// Helper Containers
-		std::vector<uint32_t> vertexCounter{};
+		uint32_t lod{};
+		// Copies of worldMatrix and lod for the back end, made when the frame is handed over (see Renderer::Render)
+		Matrix renderWorldMatrix{};
+		uint32_t renderLod{};
+		Matrix worldViewProjectionMatrix{};
+		std::vector<uint32_t> visibleMeshlets{}; // Meshlets that survived culling this frame, front to back while depth sorting is on
+		std::vector<uint32_t> visibleVertices{}; // Their vertices, only filled in when some meshlets were culled
+		// Only the visible vertices are transformed, vertexSlots maps a mesh vertex to its transformed one
+		std::vector<Vertex_Out> vertices_out{};
+		std::vector<uint32_t> vertexSlots{};
 	};
 }
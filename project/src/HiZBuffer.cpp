@@ -0,0 +1,137 @@
+#include "HiZBuffer.h"
+
+#include <algorithm>
+
+namespace dae
+{
+	HiZBuffer::HiZBuffer(int width, int height, const float* pDepthBuffer) :
+		m_Width{ width },
+		m_Height{ height },
+		m_pDepthBuffer{ pDepthBuffer }
+	{
+		// Level 0 are the 8x8 tiles, keep halving until a single cell covers the screen
+		int levelWidth = (width + TileSize - 1) / TileSize;
+		int levelHeight = (height + TileSize - 1) / TileSize;
+		while (true)
+		{
+			Level level{};
+			level.width = levelWidth;
+			level.height = levelHeight;
+			level.maxDepths.resize(levelWidth * levelHeight);
+			level.dirtyFlags.resize(levelWidth * levelHeight);
+			m_vLevels.emplace_back(std::move(level));
+
+			if (levelWidth == 1 and levelHeight == 1) break;
+			levelWidth = (levelWidth + 1) / 2;
+			levelHeight = (levelHeight + 1) / 2;
+		}
+	}
+
+	void HiZBuffer::Clear(float depth)
+	{
+		for (Level& level : m_vLevels)
+		{
+			std::fill(level.maxDepths.begin(), level.maxDepths.end(), depth);
+			std::fill(level.dirtyFlags.begin(), level.dirtyFlags.end(), uint8_t{ 0 });
+			level.dirtyCells.clear();
+		}
+	}
+
+	void HiZBuffer::MarkTileDirty(int tileX, int tileY)
+	{
+		MarkCellDirty(0, tileX, tileY);
+	}
+
+	void HiZBuffer::MarkCellDirty(int levelIndex, int cellX, int cellY)
+	{
+		Level& level = m_vLevels[levelIndex];
+		const int cellIndex = cellY * level.width + cellX;
+		if (level.dirtyFlags[cellIndex]) return;
+
+		level.dirtyFlags[cellIndex] = 1;
+		level.dirtyCells.emplace_back(cellIndex);
+	}
+
+	void HiZBuffer::Update()
+	{
+		// Tiles read the depth buffer, the levels above only the 2x2 cells below them
+		for (size_t levelIndex{}; levelIndex < m_vLevels.size(); ++levelIndex)
+		{
+			Level& level = m_vLevels[levelIndex];
+			for (int cellIndex : level.dirtyCells)
+			{
+				const int cellX = cellIndex % level.width;
+				const int cellY = cellIndex / level.width;
+
+				float maxDepth{};
+				if (levelIndex == 0)
+				{
+					maxDepth = CalculateTileMaxDepth(cellX, cellY);
+				}
+				else
+				{
+					const Level& childLevel = m_vLevels[levelIndex - 1];
+					const int endX = std::min(cellX * 2 + 2, childLevel.width);
+					const int endY = std::min(cellY * 2 + 2, childLevel.height);
+					for (int childY{ cellY * 2 }; childY < endY; ++childY)
+					{
+						for (int childX{ cellX * 2 }; childX < endX; ++childX)
+							maxDepth = std::max(maxDepth, childLevel.maxDepths[childY * childLevel.width + childX]);
+					}
+				}
+
+				level.maxDepths[cellIndex] = maxDepth;
+				level.dirtyFlags[cellIndex] = 0;
+				if (levelIndex + 1 < m_vLevels.size()) MarkCellDirty(int(levelIndex) + 1, cellX / 2, cellY / 2);
+			}
+			level.dirtyCells.clear();
+		}
+	}
+
+	void HiZBuffer::UpdateTile(int tileX, int tileY)
+	{
+		Level& tiles = m_vLevels[0];
+		tiles.maxDepths[tileY * tiles.width + tileX] = CalculateTileMaxDepth(tileX, tileY);
+	}
+
+	float HiZBuffer::CalculateTileMaxDepth(int tileX, int tileY) const
+	{
+		float maxDepth{};
+		const int endX = std::min((tileX + 1) * TileSize, m_Width);
+		const int endY = std::min((tileY + 1) * TileSize, m_Height);
+		for (int py{ tileY * TileSize }; py < endY; ++py)
+		{
+			for (int px{ tileX * TileSize }; px < endX; ++px)
+				maxDepth = std::max(maxDepth, m_pDepthBuffer[py * m_Width + px]);
+		}
+		return maxDepth;
+	}
+
+	bool HiZBuffer::IsOccluded(int minX, int minY, int maxX, int maxY, float minDepth) const
+	{
+		// Go up until the rectangle touches at most 2x2 cells
+		int cellMinX = minX / TileSize;
+		int cellMinY = minY / TileSize;
+		int cellMaxX = maxX / TileSize;
+		int cellMaxY = maxY / TileSize;
+		size_t levelIndex{};
+		while ((cellMaxX - cellMinX > 1 or cellMaxY - cellMinY > 1) and levelIndex + 1 < m_vLevels.size())
+		{
+			cellMinX /= 2;
+			cellMinY /= 2;
+			cellMaxX /= 2;
+			cellMaxY /= 2;
+			++levelIndex;
+		}
+
+		const Level& level = m_vLevels[levelIndex];
+		for (int cellY{ cellMinY }; cellY <= cellMaxY; ++cellY)
+		{
+			for (int cellX{ cellMinX }; cellX <= cellMaxX; ++cellX)
+			{
+				if (minDepth <= level.maxDepths[cellY * level.width + cellX]) return false;
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace dae
+{
+	// Coarse max-depth pyramid over the depth buffer, level 0 holds the farthest depth of every 8x8 tile,
+	// every level above halves the resolution. Values are conservative, they can only be too far, never too close
+	class HiZBuffer final
+	{
+	public:
+		static constexpr int TileSize{ 8 };
+
+		HiZBuffer(int width, int height, const float* pDepthBuffer);
+
+		void Clear(float depth);
+
+		// Depth writes made the tile stale, Update refreshes it and the levels above
+		void MarkTileDirty(int tileX, int tileY);
+		void Update();
+		// Refreshes just the tile, the levels above wait for Update. Only touches the tile itself, so tasks that own
+		// different tiles can call it at the same time
+		void UpdateTile(int tileX, int tileY);
+
+		float GetTileMaxDepth(int tileX, int tileY) const { return m_vLevels[0].maxDepths[tileY * m_vLevels[0].width + tileX]; }
+
+		// True if everything within the pixel rectangle (inclusive) is closer than minDepth
+		bool IsOccluded(int minX, int minY, int maxX, int maxY, float minDepth) const;
+
+	private:
+		struct Level
+		{
+			int width{};
+			int height{};
+			std::vector<float> maxDepths{};
+			std::vector<uint8_t> dirtyFlags{};
+			std::vector<int> dirtyCells{};
+		};
+
+		void MarkCellDirty(int levelIndex, int cellX, int cellY);
+		float CalculateTileMaxDepth(int tileX, int tileY) const;
+
+		int m_Width{};
+		int m_Height{};
+		const float* m_pDepthBuffer{};
+
+		std::vector<Level> m_vLevels{};
+	};
+}
@@ -0,0 +1,101 @@
+#include "InstanceBvh.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace dae
+{
+	namespace
+	{
+		BoundingBox Merge(const BoundingBox& a, const BoundingBox& b)
+		{
+			return { Vector3::Min(a.min, b.min), Vector3::Max(a.max, b.max) };
+		}
+
+		// Exact, Vector3::operator== has a tolerance and a parent a hair too small would cull what it holds
+		bool IsSame(const BoundingBox& a, const BoundingBox& b)
+		{
+			return a.min.x == b.min.x and a.min.y == b.min.y and a.min.z == b.min.z
+				and a.max.x == b.max.x and a.max.y == b.max.y and a.max.z == b.max.z;
+		}
+	}
+
+	void InstanceBvh::Build(const std::vector<BoundingBox>& bounds)
+	{
+		m_vItemBounds = bounds;
+		m_vItems.resize(bounds.size());
+		std::iota(m_vItems.begin(), m_vItems.end(), 0);
+		m_vItemLeaves.resize(bounds.size());
+		m_vNodes.clear();
+		if (bounds.empty()) return;
+
+		// A balanced tree with leaves of LeafSize items has at most twice as many nodes as leaves
+		m_vNodes.reserve(2 * (bounds.size() / LeafSize + 1));
+		BuildNode(UINT32_MAX, 0, uint32_t(bounds.size()));
+	}
+
+	uint32_t InstanceBvh::BuildNode(uint32_t parent, uint32_t firstItem, uint32_t lastItem)
+	{
+		const uint32_t nodeIndex = uint32_t(m_vNodes.size());
+		m_vNodes.emplace_back().parent = parent;
+
+		BoundingBox bounds{}, centers{};
+		for (uint32_t itemIndex{ firstItem }; itemIndex < lastItem; ++itemIndex)
+		{
+			const BoundingBox& itemBounds = m_vItemBounds[m_vItems[itemIndex]];
+			bounds = Merge(bounds, itemBounds);
+			const Vector3 center = (itemBounds.min + itemBounds.max) * 0.5f;
+			centers = Merge(centers, { center, center });
+		}
+		m_vNodes[nodeIndex].bounds = bounds;
+
+		if (lastItem - firstItem <= LeafSize)
+		{
+			m_vNodes[nodeIndex].first = firstItem;
+			m_vNodes[nodeIndex].itemCount = lastItem - firstItem;
+			for (uint32_t itemIndex{ firstItem }; itemIndex < lastItem; ++itemIndex)
+				m_vItemLeaves[m_vItems[itemIndex]] = nodeIndex;
+			return nodeIndex;
+		}
+
+		// Median of the centers along the axis they spread the most on
+		const Vector3 spread = centers.max - centers.min;
+		const int axis = spread.x >= spread.y and spread.x >= spread.z ? 0 : (spread.y >= spread.z ? 1 : 2);
+		const uint32_t middleItem = firstItem + (lastItem - firstItem) / 2;
+		std::nth_element(m_vItems.begin() + firstItem, m_vItems.begin() + middleItem, m_vItems.begin() + lastItem, [&](uint32_t a, uint32_t b)
+			{
+				return m_vItemBounds[a].min[axis] + m_vItemBounds[a].max[axis] < m_vItemBounds[b].min[axis] + m_vItemBounds[b].max[axis];
+			});
+
+		BuildNode(nodeIndex, firstItem, middleItem);
+		const uint32_t rightChild = BuildNode(nodeIndex, middleItem, lastItem);
+		m_vNodes[nodeIndex].first = rightChild;
+		return nodeIndex;
+	}
+
+	BoundingBox InstanceBvh::CalculateNodeBounds(const Node& node) const
+	{
+		if (node.itemCount == 0)
+		{
+			const uint32_t nodeIndex = uint32_t(&node - m_vNodes.data());
+			return Merge(m_vNodes[nodeIndex + 1].bounds, m_vNodes[node.first].bounds);
+		}
+
+		BoundingBox bounds{};
+		for (uint32_t itemIndex{ node.first }; itemIndex < node.first + node.itemCount; ++itemIndex)
+			bounds = Merge(bounds, m_vItemBounds[m_vItems[itemIndex]]);
+		return bounds;
+	}
+
+	void InstanceBvh::Refit(uint32_t item, const BoundingBox& bounds)
+	{
+		m_vItemBounds[item] = bounds;
+		for (uint32_t nodeIndex = m_vItemLeaves[item]; nodeIndex != UINT32_MAX; nodeIndex = m_vNodes[nodeIndex].parent)
+		{
+			Node& node = m_vNodes[nodeIndex];
+			const BoundingBox nodeBounds = CalculateNodeBounds(node);
+			if (IsSame(nodeBounds, node.bounds)) return;
+			node.bounds = nodeBounds;
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Bounding volume hierarchy over one world space box per instance. Built top down by splitting at the median of the
+	// longest axis, so it stays balanced. When boxes move only the nodes above them are refit, the tree itself is kept
+	class InstanceBvh final
+	{
+	public:
+		static constexpr uint32_t LeafSize{ 4 };
+
+		void Build(const std::vector<BoundingBox>& bounds);
+		// Updates one box and the nodes above it, stops at the first one that doesn't change
+		void Refit(uint32_t item, const BoundingBox& bounds);
+
+		size_t GetItemCount() const { return m_vItemBounds.size(); }
+
+		// Descends into the nodes whose box passes isVisible(bounds), calls onItem(item) for every item of the leaves reached.
+		// The items still need their own test, a leaf box also covers its neighbours
+		template<typename NodeTest, typename ItemFunction>
+		void Query(NodeTest&& isVisible, ItemFunction&& onItem) const
+		{
+			if (m_vNodes.empty()) return;
+
+			// Balanced, so the depth stays far below the stack size for any realistic scene
+			std::array<uint32_t, 64> stack{};
+			uint32_t stackSize{};
+			stack[stackSize++] = 0;
+			while (stackSize > 0)
+			{
+				const Node& node = m_vNodes[stack[--stackSize]];
+				if (!isVisible(node.bounds)) continue;
+
+				if (node.itemCount > 0)
+				{
+					for (uint32_t itemIndex{ node.first }; itemIndex < node.first + node.itemCount; ++itemIndex)
+						onItem(m_vItems[itemIndex]);
+					continue;
+				}
+				// Left child last, so it is visited first
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = uint32_t(&node - m_vNodes.data()) + 1;
+			}
+		}
+
+	private:
+		struct Node
+		{
+			BoundingBox bounds{};
+			uint32_t parent{ UINT32_MAX };
+			uint32_t first{};		// Leaves: first index into m_vItems, inner nodes: the right child, the left one follows the node
+			uint32_t itemCount{};	// Zero for inner nodes
+		};
+
+		uint32_t BuildNode(uint32_t parent, uint32_t firstItem, uint32_t lastItem);
+		BoundingBox CalculateNodeBounds(const Node& node) const;
+
+		std::vector<Node> m_vNodes{};
+		std::vector<uint32_t> m_vItems{};		// Grouped per leaf
+		std::vector<uint32_t> m_vItemLeaves{};
+		std::vector<BoundingBox> m_vItemBounds{};
+	};
+}
@@ -0,0 +1,153 @@
+#include "JobSystem.h"
+
+#include <utility>
+
+namespace dae
+{
+	namespace
+	{
+		// Queue of the current thread, only valid for the JobSystem that started it
+		thread_local const JobSystem* t_pJobSystem{};
+		thread_local uint32_t t_QueueIndex{};
+
+		// Work tends to come in bursts within a frame, a short spin avoids going to sleep between two of them
+		constexpr int IdleSpinCount{ 256 };
+	}
+
+	JobSystem::JobSystem(uint32_t threadCount) :
+		m_ThreadCount{ std::max(threadCount, 1u) }
+	{
+		m_pQueues = std::make_unique<TaskQueue[]>(m_ThreadCount);
+		m_vWorkers.reserve(m_ThreadCount - 1);
+		for (uint32_t queueIndex{ 1 }; queueIndex < m_ThreadCount; ++queueIndex)
+			m_vWorkers.emplace_back(&JobSystem::WorkerLoop, this, queueIndex);
+	}
+
+	JobSystem::~JobSystem()
+	{
+		m_IsStopping = true;
+		{
+			std::lock_guard lock{ m_SleepMutex };
+		}
+		m_WakeCondition.notify_all();
+		for (std::thread& worker : m_vWorkers)
+			worker.join();
+	}
+
+	void JobSystem::Wait(TaskGroup& group)
+	{
+		const uint32_t queueIndex = GetQueueIndex();
+		while (group.m_PendingCount.load(std::memory_order_acquire) > 0)
+		{
+			if (!TryRunTask(queueIndex)) std::this_thread::yield();
+		}
+
+		if (group.m_HasException.exchange(false))
+			std::rethrow_exception(std::exchange(group.m_Exception, nullptr));
+	}
+
+	uint32_t JobSystem::GetQueueIndex() const
+	{
+		return t_pJobSystem == this ? t_QueueIndex : 0;
+	}
+
+	void JobSystem::Push(const Task& task, uint32_t grainSize)
+	{
+		const uint32_t rangeSize = task.end - task.begin;
+		const uint32_t taskCount = rangeSize == 0 ? 1 : (rangeSize - 1) / grainSize + 1;
+
+		// Counted before they are queued, a thief could otherwise finish one before its group knows about it
+		task.pGroup->m_PendingCount.fetch_add(taskCount, std::memory_order_relaxed);
+		m_QueuedCount.fetch_add(taskCount);
+
+		TaskQueue& queue = m_pQueues[GetQueueIndex()];
+		{
+			std::lock_guard lock{ queue.mutex };
+			Task piece = task;
+			for (uint32_t taskIndex{}; taskIndex < taskCount; ++taskIndex)
+			{
+				piece.end = task.end - piece.begin <= grainSize ? task.end : piece.begin + grainSize;
+				queue.tasks.emplace_back(piece);
+				piece.begin = piece.end;
+			}
+		}
+
+		if (m_SleepingCount.load() > 0)
+		{
+			{
+				std::lock_guard lock{ m_SleepMutex };
+			}
+			m_WakeCondition.notify_all();
+		}
+	}
+
+	bool JobSystem::TryRunTask(uint32_t queueIndex)
+	{
+		const uint32_t queueCount = GetThreadCount();
+		Task task{};
+		bool hasTask{};
+
+		// Newest task of our own first, it is most likely still in cache. Then the oldest of the others, the biggest piece of work left
+		{
+			TaskQueue& queue = m_pQueues[queueIndex];
+			std::lock_guard lock{ queue.mutex };
+			if (!queue.tasks.empty())
+			{
+				task = queue.tasks.back();
+				queue.tasks.pop_back();
+				hasTask = true;
+			}
+		}
+		for (uint32_t offset{ 1 }; !hasTask and offset < queueCount; ++offset)
+		{
+			TaskQueue& queue = m_pQueues[(queueIndex + offset) % queueCount];
+			std::lock_guard lock{ queue.mutex };
+			if (!queue.tasks.empty())
+			{
+				task = queue.tasks.front();
+				queue.tasks.pop_front();
+				hasTask = true;
+			}
+		}
+		if (!hasTask) return false;
+
+		m_QueuedCount.fetch_sub(1);
+		Execute(task);
+		return true;
+	}
+
+	void JobSystem::Execute(const Task& task)
+	{
+		try
+		{
+			task.execute(task.pContext, task.begin, task.end);
+		}
+		catch (...)
+		{
+			// Only the first one is kept
+			if (!task.pGroup->m_HasException.exchange(true)) task.pGroup->m_Exception = std::current_exception();
+		}
+		task.pGroup->m_PendingCount.fetch_sub(1, std::memory_order_release);
+	}
+
+	void JobSystem::WorkerLoop(uint32_t queueIndex)
+	{
+		t_pJobSystem = this;
+		t_QueueIndex = queueIndex;
+
+		while (!m_IsStopping)
+		{
+			if (TryRunTask(queueIndex)) continue;
+
+			for (int spin{}; spin < IdleSpinCount and m_QueuedCount.load(std::memory_order_relaxed) == 0; ++spin)
+				std::this_thread::yield();
+			if (m_QueuedCount.load(std::memory_order_relaxed) > 0) continue;
+
+			// Both counters are sequentially consistent, so either Push sees us sleeping or we see its task
+			std::unique_lock lock{ m_SleepMutex };
+			++m_SleepingCount;
+			m_WakeCondition.wait(lock, [this] { return m_QueuedCount.load() > 0 or m_IsStopping; });
+			--m_SleepingCount;
+		}
+	}
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace dae
+{
+	class JobSystem;
+
+	// Tasks started together, Wait on it helps with the work until all of them are done
+	class TaskGroup final
+	{
+	public:
+		TaskGroup() = default;
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+
+	private:
+		friend class JobSystem;
+
+		std::atomic<uint32_t> m_PendingCount{};
+		std::atomic<bool> m_HasException{};
+		std::exception_ptr m_Exception{};
+	};
+
+	// Fixed pool of worker threads, every thread has its own deque. A thread pushes and pops at the back of its own deque,
+	// idle threads steal from the front of the others, so tasks split from the same loop stay on the thread that made them
+	// until someone runs out of work. Threads that wait for a group run its tasks instead of blocking
+	class JobSystem final
+	{
+	public:
+		// Counts the calling thread, which takes part whenever it waits
+		explicit JobSystem(uint32_t threadCount = std::thread::hardware_concurrency());
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem(JobSystem&&) noexcept = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		JobSystem& operator=(JobSystem&&) noexcept = delete;
+
+		uint32_t GetThreadCount() const { return m_ThreadCount; }
+
+		// The function is copied, exceptions are rethrown by Wait
+		template<typename Function>
+		void Run(TaskGroup& group, Function&& function);
+		void Wait(TaskGroup& group);
+
+		// Calls function(begin, end) for ranges of at most grainSize items, the calling thread runs the first range itself
+		template<typename Function>
+		void ParallelForRange(uint32_t count, uint32_t grainSize, Function&& function);
+		// Calls function(index) for every index below count, grainSize indices per task
+		template<typename Function>
+		void ParallelFor(uint32_t count, uint32_t grainSize, Function&& function);
+
+	private:
+		struct Task
+		{
+			void (*execute)(void* pContext, uint32_t begin, uint32_t end){};
+			void* pContext{};
+			uint32_t begin{};
+			uint32_t end{};
+			TaskGroup* pGroup{};
+		};
+
+		struct alignas(64) TaskQueue
+		{
+			std::mutex mutex{};
+			std::deque<Task> tasks{};
+		};
+
+		uint32_t GetQueueIndex() const;
+		// Splits the task's range in pieces of grainSize, a task without a range is pushed as is
+		void Push(const Task& task, uint32_t grainSize);
+		bool TryRunTask(uint32_t queueIndex);
+		void Execute(const Task& task);
+		void WorkerLoop(uint32_t queueIndex);
+
+		// Queue 0 belongs to the threads outside the pool, the workers have the others.
+		// The workers already run while the pool is still being filled, so they count the queues with this
+		const uint32_t m_ThreadCount;
+		std::unique_ptr<TaskQueue[]> m_pQueues{};
+		std::vector<std::thread> m_vWorkers{};
+
+		std::atomic<uint32_t> m_QueuedCount{};
+		std::atomic<uint32_t> m_SleepingCount{};
+		std::atomic<bool> m_IsStopping{};
+		std::mutex m_SleepMutex{};
+		std::condition_variable m_WakeCondition{};
+	};
+
+	template<typename Function>
+	void JobSystem::Run(TaskGroup& group, Function&& function)
+	{
+		using FunctionType = std::decay_t<Function>;
+		Task task{};
+		task.execute = [](void* pContext, uint32_t, uint32_t)
+			{
+				std::unique_ptr<FunctionType> pFunction{ static_cast<FunctionType*>(pContext) };
+				(*pFunction)();
+			};
+		task.pContext = new FunctionType(std::forward<Function>(function));
+		task.pGroup = &group;
+		Push(task, 1);
+	}
+
+	template<typename Function>
+	void JobSystem::ParallelForRange(uint32_t count, uint32_t grainSize, Function&& function)
+	{
+		if (count == 0) return;
+		grainSize = std::max(grainSize, 1u);
+		const uint32_t taskCount = (count + grainSize - 1) / grainSize;
+		if (taskCount == 1 or m_ThreadCount == 1)
+		{
+			function(0u, count);
+			return;
+		}
+
+		// The function outlives the tasks, Wait doesn't return before they are done, so they only need its address
+		using FunctionType = std::remove_reference_t<Function>;
+		TaskGroup group{};
+		Task task{};
+		task.execute = [](void* pContext, uint32_t begin, uint32_t end) { (*static_cast<FunctionType*>(pContext))(begin, end); };
+		task.pContext = const_cast<void*>(static_cast<const void*>(&function));
+		task.begin = grainSize;
+		task.end = count;
+		task.pGroup = &group;
+		Push(task, grainSize);
+
+		try
+		{
+			function(0u, grainSize);
+		}
+		catch (...)
+		{
+			// The tasks still point at the function
+			Wait(group);
+			throw;
+		}
+		Wait(group);
+	}
+
+	template<typename Function>
+	void JobSystem::ParallelFor(uint32_t count, uint32_t grainSize, Function&& function)
+	{
+		ParallelForRange(count, grainSize, [&function](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t index{ begin }; index < end; ++index)
+					function(index);
+			});
+	}
+}
@@ -212,8 +212,8 @@ namespace dae {
 	{
 		return {
 			{1,				 0,				 0,		0},
-			{0,		cos(pitch),	   -sin(pitch),		0},
-			{0,		sin(pitch),		cos(pitch),		0},
+			{0,		std::cos(pitch),	   -std::sin(pitch),		0},
+			{0,		std::sin(pitch),		std::cos(pitch),		0},
 			{0,				 0,				 0,		1}
 		};
 	}
@@ -221,9 +221,9 @@ namespace dae {
 	Matrix Matrix::CreateRotationY(float yaw)
 	{
 		return {
-			{ cos(yaw),		0,	-sin(yaw),	 0},
+			{ std::cos(yaw),		0,	-std::sin(yaw),	 0},
 			{		 0,		1,			0,	 0},
-			{ sin(yaw),		0,	 cos(yaw),	 0},
+			{ std::sin(yaw),		0,	 std::cos(yaw),	 0},
 			{		 0,		0,			0,	 1}
 		};
 	}
@@ -231,8 +231,8 @@ namespace dae {
 	Matrix Matrix::CreateRotationZ(float roll)
 	{
 		return {
-			{ cos(roll),	sin(roll),		0,		0},
-			{-sin(roll),	cos(roll),		0,		0},
+			{ std::cos(roll),	std::sin(roll),		0,		0},
+			{-std::sin(roll),	std::cos(roll),		0,		0},
 			{		  0,			0,		1,		0},
 			{		  0,			0,		0,		1}
 		};
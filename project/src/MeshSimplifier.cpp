@@ -0,0 +1,339 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+
+namespace dae
+{
+	namespace
+	{
+		// Borders and seams weigh more than the surface, they are what gives a distant mesh its silhouette
+		constexpr float BorderWeight{ 10.f };
+
+		bool IsPositionLess(const Vector3& a, const Vector3& b)
+		{
+			return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+		}
+
+		bool HaveSameAttributes(const Vertex& a, const Vertex& b)
+		{
+			return a.uv.x == b.uv.x and a.uv.y == b.uv.y
+				and a.normal.x == b.normal.x and a.normal.y == b.normal.y and a.normal.z == b.normal.z;
+		}
+	}
+
+	MeshSimplifier::Quadric MeshSimplifier::Quadric::FromPlane(const Vector3& normal, float distance, float weight)
+	{
+		const double a{ normal.x }, b{ normal.y }, c{ normal.z }, d{ distance };
+		return Quadric{ a * a * weight, a * b * weight, a * c * weight, a * d * weight,
+			b * b * weight, b * c * weight, b * d * weight,
+			c * c * weight, c * d * weight,
+			d * d * weight };
+	}
+
+	MeshSimplifier::Quadric& MeshSimplifier::Quadric::operator+=(const Quadric& other)
+	{
+		xx += other.xx; xy += other.xy; xz += other.xz; xw += other.xw;
+		yy += other.yy; yz += other.yz; yw += other.yw;
+		zz += other.zz; zw += other.zw;
+		ww += other.ww;
+		return *this;
+	}
+
+	double MeshSimplifier::Quadric::Evaluate(const Vector3& point) const
+	{
+		const double x{ point.x }, y{ point.y }, z{ point.z };
+		return xx * x * x + 2 * xy * x * y + 2 * xz * x * z + 2 * xw * x
+			+ yy * y * y + 2 * yz * y * z + 2 * yw * y
+			+ zz * z * z + 2 * zw * z
+			+ ww;
+	}
+
+	MeshSimplifier::MeshSimplifier(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) :
+		m_Vertices{ vertices }
+	{
+		// Weld, equal positions (and within those equal attributes) end up next to each other
+		std::vector<uint32_t> order(vertices.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+			{
+				const Vertex& vertexA = vertices[a];
+				const Vertex& vertexB = vertices[b];
+				if (IsPositionLess(vertexA.position, vertexB.position)) return true;
+				if (IsPositionLess(vertexB.position, vertexA.position)) return false;
+				return std::tie(vertexA.uv.x, vertexA.uv.y, vertexA.normal.x, vertexA.normal.y, vertexA.normal.z, a)
+					< std::tie(vertexB.uv.x, vertexB.uv.y, vertexB.normal.x, vertexB.normal.y, vertexB.normal.z, b);
+			});
+
+		m_vPositionIds.resize(vertices.size());
+		std::vector<uint32_t> wedges(vertices.size());
+		for (size_t orderIndex{}; orderIndex < order.size(); ++orderIndex)
+		{
+			const uint32_t vertex = order[orderIndex];
+			const uint32_t previous = orderIndex > 0 ? order[orderIndex - 1] : vertex;
+			const bool newPosition = orderIndex == 0 or IsPositionLess(vertices[previous].position, vertices[vertex].position);
+			if (newPosition)
+			{
+				m_vPositions.emplace_back(vertices[vertex].position);
+				m_vPositionWedges.emplace_back();
+			}
+			if (newPosition or !HaveSameAttributes(vertices[previous], vertices[vertex])) m_vPositionWedges.back().emplace_back(vertex);
+
+			m_vPositionIds[vertex] = uint32_t(m_vPositions.size() - 1);
+			wedges[vertex] = m_vPositionWedges.back().back();
+		}
+
+		const size_t positionCount = m_vPositions.size();
+		m_vPositionTriangles.resize(positionCount);
+		m_vQuadrics.resize(positionCount);
+		m_vKinds.resize(positionCount, VertexKind::Manifold);
+		m_vVersions.resize(positionCount);
+		m_vRemoved.resize(positionCount);
+
+		// Every position gets the planes of the triangles around it
+		std::vector<Vector3> faceNormals{};
+		for (size_t index{}; index + 2 < indices.size(); index += 3)
+		{
+			const std::array<uint32_t, 3> triangle{ wedges[indices[index]], wedges[indices[index + 1]], wedges[indices[index + 2]] };
+			const uint32_t position0 = m_vPositionIds[triangle[0]];
+			const uint32_t position1 = m_vPositionIds[triangle[1]];
+			const uint32_t position2 = m_vPositionIds[triangle[2]];
+			if (position0 == position1 or position1 == position2 or position2 == position0) continue;
+
+			const uint32_t triangleIndex = uint32_t(m_vTriangles.size());
+			m_vTriangles.emplace_back(triangle);
+			for (uint32_t position : { position0, position1, position2 }) m_vPositionTriangles[position].emplace_back(triangleIndex);
+
+			const Vector3& p0 = m_vPositions[position0];
+			Vector3 normal = Vector3::Cross(m_vPositions[position1] - p0, m_vPositions[position2] - p0);
+			if (normal.Normalize() <= FLT_EPSILON) normal = Vector3::Zero;
+			faceNormals.emplace_back(normal);
+
+			const Quadric quadric = Quadric::FromPlane(normal, -Vector3::Dot(normal, p0), 1.f);
+			for (uint32_t position : { position0, position1, position2 }) m_vQuadrics[position] += quadric;
+		}
+		m_TriangleCount = uint32_t(m_vTriangles.size());
+		m_vTrianglesRemoved.resize(m_vTriangles.size());
+
+		// Edges used by one triangle, more than two, or two that disagree on the attributes are borders
+		struct Edge
+		{
+			uint32_t triangle{};
+			uint32_t wedge0{};
+			uint32_t wedge1{};
+			uint32_t triangleCount{};
+			bool seam{};
+		};
+		std::unordered_map<uint64_t, Edge> edges{};
+		edges.reserve(m_vTriangles.size() * 2);
+		for (uint32_t triangleIndex{}; triangleIndex < m_vTriangles.size(); ++triangleIndex)
+		{
+			for (int corner{}; corner < 3; ++corner)
+			{
+				uint32_t wedge0 = m_vTriangles[triangleIndex][corner];
+				uint32_t wedge1 = m_vTriangles[triangleIndex][(corner + 1) % 3];
+				if (m_vPositionIds[wedge0] > m_vPositionIds[wedge1]) std::swap(wedge0, wedge1);
+				const uint64_t key = uint64_t(m_vPositionIds[wedge0]) << 32 | m_vPositionIds[wedge1];
+
+				const auto [it, inserted] = edges.try_emplace(key, Edge{ triangleIndex, wedge0, wedge1 });
+				if (!inserted and (it->second.wedge0 != wedge0 or it->second.wedge1 != wedge1)) it->second.seam = true;
+				++it->second.triangleCount;
+			}
+		}
+
+		std::vector<uint32_t> borderEdgeCounts(positionCount);
+		for (const auto& [key, edge] : edges)
+		{
+			if (edge.triangleCount == 2 and !edge.seam) continue;
+
+			const uint32_t position0 = m_vPositionIds[edge.wedge0];
+			const uint32_t position1 = m_vPositionIds[edge.wedge1];
+			++borderEdgeCounts[position0];
+			++borderEdgeCounts[position1];
+
+			// The plane through the edge, perpendicular to the triangle, keeps the border where it is
+			const Vector3& p0 = m_vPositions[position0];
+			Vector3 normal = Vector3::Cross(m_vPositions[position1] - p0, faceNormals[edge.triangle]);
+			if (normal.Normalize() <= FLT_EPSILON) continue;
+			const Quadric quadric = Quadric::FromPlane(normal, -Vector3::Dot(normal, p0), BorderWeight);
+			m_vQuadrics[position0] += quadric;
+			m_vQuadrics[position1] += quadric;
+		}
+		for (size_t position{}; position < positionCount; ++position)
+		{
+			if (borderEdgeCounts[position] == 0) m_vKinds[position] = VertexKind::Manifold;
+			else if (borderEdgeCounts[position] == 2) m_vKinds[position] = VertexKind::Border;
+			else m_vKinds[position] = VertexKind::Locked;
+		}
+
+		for (const auto& [key, edge] : edges)
+		{
+			PushCollapse(m_vPositionIds[edge.wedge0], m_vPositionIds[edge.wedge1]);
+			PushCollapse(m_vPositionIds[edge.wedge1], m_vPositionIds[edge.wedge0]);
+		}
+	}
+
+	void MeshSimplifier::Simplify(uint32_t targetTriangleCount, float maxError)
+	{
+		const double maxCost = double(maxError) * maxError;
+		while (m_TriangleCount > targetTriangleCount and !m_vCollapseHeap.empty())
+		{
+			// The cheapest collapse left is already too expensive, it stays on the heap for a call with a larger maxError
+			if (m_vCollapseHeap.front().cost > maxCost) break;
+
+			std::pop_heap(m_vCollapseHeap.begin(), m_vCollapseHeap.end(), std::greater<>{});
+			const Collapse collapse = m_vCollapseHeap.back();
+			m_vCollapseHeap.pop_back();
+
+			// One of the two changed since this was pushed, it was pushed again with the new cost
+			if (m_vRemoved[collapse.from] or m_vRemoved[collapse.to]) continue;
+			if (m_vVersions[collapse.from] != collapse.fromVersion or m_vVersions[collapse.to] != collapse.toVersion) continue;
+
+			if (m_vKinds[collapse.from] == VertexKind::Border and !IsBorderEdge(collapse.from, collapse.to)) continue;
+			if (FlipsTriangle(collapse.from, collapse.to)) continue;
+
+			m_MaxCost = std::max(m_MaxCost, collapse.cost);
+			ApplyCollapse(collapse.from, collapse.to);
+		}
+	}
+
+	float MeshSimplifier::GetError() const
+	{
+		return float(std::sqrt(std::max(m_MaxCost, 0.0)));
+	}
+
+	std::vector<uint32_t> MeshSimplifier::GetIndices() const
+	{
+		std::vector<uint32_t> indices{};
+		indices.reserve(m_TriangleCount * 3);
+		for (size_t triangleIndex{}; triangleIndex < m_vTriangles.size(); ++triangleIndex)
+		{
+			if (m_vTrianglesRemoved[triangleIndex]) continue;
+			indices.insert(indices.end(), m_vTriangles[triangleIndex].begin(), m_vTriangles[triangleIndex].end());
+		}
+		return indices;
+	}
+
+	void MeshSimplifier::PushCollapses(uint32_t position)
+	{
+		std::vector<uint32_t> neighbours{};
+		for (uint32_t triangleIndex : m_vPositionTriangles[position])
+		{
+			for (uint32_t wedge : m_vTriangles[triangleIndex])
+			{
+				const uint32_t neighbour = m_vPositionIds[wedge];
+				if (neighbour == position or std::find(neighbours.begin(), neighbours.end(), neighbour) != neighbours.end()) continue;
+				neighbours.emplace_back(neighbour);
+			}
+		}
+
+		for (uint32_t neighbour : neighbours)
+		{
+			PushCollapse(position, neighbour);
+			PushCollapse(neighbour, position);
+		}
+	}
+
+	void MeshSimplifier::PushCollapse(uint32_t from, uint32_t to)
+	{
+		if (m_vKinds[from] == VertexKind::Locked) return;
+		// A border vertex can only slide along the border
+		if (m_vKinds[from] == VertexKind::Border and m_vKinds[to] == VertexKind::Manifold) return;
+
+		Quadric quadric = m_vQuadrics[from];
+		quadric += m_vQuadrics[to];
+		m_vCollapseHeap.emplace_back(Collapse{ quadric.Evaluate(m_vPositions[to]), from, to, m_vVersions[from], m_vVersions[to] });
+		std::push_heap(m_vCollapseHeap.begin(), m_vCollapseHeap.end(), std::greater<>{});
+	}
+
+	bool MeshSimplifier::IsBorderEdge(uint32_t from, uint32_t to) const
+	{
+		uint32_t triangleCount{};
+		uint32_t fromWedge{}, toWedge{};
+		for (uint32_t triangleIndex : m_vPositionTriangles[from])
+		{
+			if (m_vTrianglesRemoved[triangleIndex]) continue;
+			const std::array<uint32_t, 3>& triangle = m_vTriangles[triangleIndex];
+			const auto toCorner = std::find_if(triangle.begin(), triangle.end(), [&](uint32_t wedge) { return m_vPositionIds[wedge] == to; });
+			if (toCorner == triangle.end()) continue;
+			const uint32_t triangleFromWedge = *std::find_if(triangle.begin(), triangle.end(), [&](uint32_t wedge) { return m_vPositionIds[wedge] == from; });
+
+			if (triangleCount > 0 and (triangleFromWedge != fromWedge or *toCorner != toWedge)) return true;
+			fromWedge = triangleFromWedge;
+			toWedge = *toCorner;
+			++triangleCount;
+		}
+		return triangleCount != 2;
+	}
+
+	bool MeshSimplifier::FlipsTriangle(uint32_t from, uint32_t to) const
+	{
+		for (uint32_t triangleIndex : m_vPositionTriangles[from])
+		{
+			if (m_vTrianglesRemoved[triangleIndex]) continue;
+			const std::array<uint32_t, 3>& triangle = m_vTriangles[triangleIndex];
+			std::array<uint32_t, 3> positions{ m_vPositionIds[triangle[0]], m_vPositionIds[triangle[1]], m_vPositionIds[triangle[2]] };
+			// These disappear
+			if (std::find(positions.begin(), positions.end(), to) != positions.end()) continue;
+
+			const Vector3 oldNormal = Vector3::Cross(m_vPositions[positions[1]] - m_vPositions[positions[0]], m_vPositions[positions[2]] - m_vPositions[positions[0]]);
+			std::replace(positions.begin(), positions.end(), from, to);
+			const Vector3 newNormal = Vector3::Cross(m_vPositions[positions[1]] - m_vPositions[positions[0]], m_vPositions[positions[2]] - m_vPositions[positions[0]]);
+			if (Vector3::Dot(oldNormal, newNormal) <= 0.f) return true;
+		}
+		return false;
+	}
+
+	uint32_t MeshSimplifier::FindClosestWedge(uint32_t wedge, uint32_t position) const
+	{
+		// Closest uv and normal, so the triangle keeps sampling the same side of a seam
+		const Vertex& vertex = m_Vertices[wedge];
+		uint32_t closestWedge{ m_vPositionWedges[position].front() };
+		float closestDistance{ FLT_MAX };
+		for (uint32_t candidate : m_vPositionWedges[position])
+		{
+			const Vertex& candidateVertex = m_Vertices[candidate];
+			const float distance = (candidateVertex.uv - vertex.uv).SqrMagnitude() + (candidateVertex.normal - vertex.normal).SqrMagnitude();
+			if (distance >= closestDistance) continue;
+			closestDistance = distance;
+			closestWedge = candidate;
+		}
+		return closestWedge;
+	}
+
+	void MeshSimplifier::ApplyCollapse(uint32_t from, uint32_t to)
+	{
+		for (uint32_t triangleIndex : m_vPositionTriangles[from])
+		{
+			// Removed by an earlier collapse of one of its other corners
+			if (m_vTrianglesRemoved[triangleIndex]) continue;
+			std::array<uint32_t, 3>& triangle = m_vTriangles[triangleIndex];
+			const bool degenerate = std::any_of(triangle.begin(), triangle.end(), [&](uint32_t wedge) { return m_vPositionIds[wedge] == to; });
+			if (degenerate)
+			{
+				m_vTrianglesRemoved[triangleIndex] = true;
+				--m_TriangleCount;
+				continue;
+			}
+
+			for (uint32_t& wedge : triangle)
+			{
+				if (m_vPositionIds[wedge] == from) wedge = FindClosestWedge(wedge, to);
+			}
+			m_vPositionTriangles[to].emplace_back(triangleIndex);
+		}
+		m_vPositionTriangles[from].clear();
+
+		// Removed triangles stay in the lists of their other corners until those collapse, or are cleaned up here
+		std::erase_if(m_vPositionTriangles[to], [&](uint32_t triangleIndex) { return m_vTrianglesRemoved[triangleIndex]; });
+
+		m_vQuadrics[to] += m_vQuadrics[from];
+		m_vRemoved[from] = true;
+		++m_vVersions[to];
+
+		PushCollapses(to);
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Quadric edge collapse (Garland-Heckbert) that only collapses a vertex onto one of its neighbours, so every level
+	// keeps indexing the original vertices. Corners are welded by position first, vertices on a border or an attribute
+	// seam (uv, normal) only slide along it and the corners of seams never move
+	class MeshSimplifier final
+	{
+	public:
+		// Triangle list into vertices
+		MeshSimplifier(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+		// Collapses the cheapest edges until at most targetTriangleCount triangles are left, or no collapse within maxError is left.
+		// Every call continues where the previous one stopped, so a chain of levels only gets coarser
+		void Simplify(uint32_t targetTriangleCount, float maxError);
+
+		uint32_t GetTriangleCount() const { return m_TriangleCount; }
+		// Largest collapse cost so far as an object space distance, conservative
+		float GetError() const;
+		// Triangle list into the original vertices, in the original triangle order
+		std::vector<uint32_t> GetIndices() const;
+
+	private:
+		// Symmetric 4x4 matrix, the sum of the squared distances to a set of planes
+		struct Quadric
+		{
+			double xx{}, xy{}, xz{}, xw{}, yy{}, yz{}, yw{}, zz{}, zw{}, ww{};
+
+			static Quadric FromPlane(const Vector3& normal, float distance, float weight);
+			Quadric& operator+=(const Quadric& other);
+			double Evaluate(const Vector3& point) const;
+		};
+
+		enum class VertexKind : uint8_t
+		{
+			Manifold,
+			Border, // On exactly two border or seam edges, slides along them
+			Locked
+		};
+
+		struct Collapse
+		{
+			double cost{};
+			uint32_t from{};
+			uint32_t to{};
+			uint32_t fromVersion{};
+			uint32_t toVersion{};
+
+			bool operator>(const Collapse& other) const { return cost > other.cost; }
+		};
+
+		void PushCollapses(uint32_t position);
+		void PushCollapse(uint32_t from, uint32_t to);
+		bool IsBorderEdge(uint32_t from, uint32_t to) const;
+		bool FlipsTriangle(uint32_t from, uint32_t to) const;
+		uint32_t FindClosestWedge(uint32_t wedge, uint32_t position) const;
+		void ApplyCollapse(uint32_t from, uint32_t to);
+
+		const std::vector<Vertex>& m_Vertices;
+
+		// Per vertex, the welded position
+		std::vector<uint32_t> m_vPositionIds{};
+
+		// Per welded position
+		std::vector<Vector3> m_vPositions{};
+		std::vector<std::vector<uint32_t>> m_vPositionWedges{};
+		std::vector<std::vector<uint32_t>> m_vPositionTriangles{};
+		std::vector<Quadric> m_vQuadrics{};
+		std::vector<VertexKind> m_vKinds{};
+		std::vector<uint32_t> m_vVersions{};
+		std::vector<uint8_t> m_vRemoved{};
+
+		// Corners are wedges, the first vertex with a given position and attributes
+		std::vector<std::array<uint32_t, 3>> m_vTriangles{};
+		std::vector<uint8_t> m_vTrianglesRemoved{};
+		uint32_t m_TriangleCount{};
+
+		std::vector<Collapse> m_vCollapseHeap{};
+		double m_MaxCost{};
+	};
+}
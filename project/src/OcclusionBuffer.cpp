@@ -0,0 +1,132 @@
+#include "OcclusionBuffer.h"
+#include "Vector2.h"
+#include "Vector4.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dae
+{
+	namespace
+	{
+		constexpr int SubSampleSteps{ 16 };
+
+		struct FixedPoint
+		{
+			int64_t x{};
+			int64_t y{};
+		};
+
+		int64_t ToFixedPoint(float value)
+		{
+			return int64_t(std::lround(value * SubSampleSteps));
+		}
+
+		int64_t EdgeFunction(const FixedPoint& a, const FixedPoint& b, const FixedPoint& point)
+		{
+			return (b.x - a.x) * (point.y - a.y) - (b.y - a.y) * (point.x - a.x);
+		}
+	}
+
+	OcclusionBuffer::OcclusionBuffer(int width, int height) :
+		m_Width{ width },
+		m_Height{ height }
+	{
+		m_vCells.resize(width * height);
+	}
+
+	void OcclusionBuffer::Clear()
+	{
+		std::fill(m_vCells.begin(), m_vCells.end(), Cell{});
+	}
+
+	void OcclusionBuffer::RasterizeOccluder(const Vector4& v0, const Vector4& v1, const Vector4& v2)
+	{
+		if (v0.w <= 0 or v1.w <= 0 or v2.w <= 0) return;
+		if (v0.z < 0 or v1.z < 0 or v2.z < 0) return;
+		// Keeps the fixed point math from overflowing, occluders are optional so dropping these is still conservative
+		constexpr float guardBand{ 64.f };
+		if (std::max({ std::abs(v0.x), std::abs(v0.y), std::abs(v1.x), std::abs(v1.y), std::abs(v2.x), std::abs(v2.y) }) > guardBand) return;
+
+		// NDC to sample coordinates
+		const float sampleWidth = float(m_Width * CellSamples);
+		const float sampleHeight = float(m_Height * CellSamples);
+		const Vector2 p0{ (1.f + v0.x) * 0.5f * sampleWidth, (1.f - v0.y) * 0.5f * sampleHeight };
+		const Vector2 p1{ (1.f + v1.x) * 0.5f * sampleWidth, (1.f - v1.y) * 0.5f * sampleHeight };
+		const Vector2 p2{ (1.f + v2.x) * 0.5f * sampleWidth, (1.f - v2.y) * 0.5f * sampleHeight };
+
+		// Snapped to fixed point so the edge tests are exact, triangles that share an edge leave no samples uncovered between them
+		const FixedPoint f0{ ToFixedPoint(p0.x), ToFixedPoint(p0.y) };
+		const FixedPoint f1{ ToFixedPoint(p1.x), ToFixedPoint(p1.y) };
+		const FixedPoint f2{ ToFixedPoint(p2.x), ToFixedPoint(p2.y) };
+
+		const int64_t area = EdgeFunction(f0, f1, f2);
+		if (area == 0) return;
+		// Same edge test for both windings
+		const int64_t windingSign = area > 0 ? 1 : -1;
+
+		const float maxDepth = std::max(v0.z, std::max(v1.z, v2.z));
+
+		const int minCellX = std::clamp(int(std::min(p0.x, std::min(p1.x, p2.x))) / CellSamples, 0, m_Width - 1);
+		const int minCellY = std::clamp(int(std::min(p0.y, std::min(p1.y, p2.y))) / CellSamples, 0, m_Height - 1);
+		const int maxCellX = std::clamp(int(std::max(p0.x, std::max(p1.x, p2.x))) / CellSamples, 0, m_Width - 1);
+		const int maxCellY = std::clamp(int(std::max(p0.y, std::max(p1.y, p2.y))) / CellSamples, 0, m_Height - 1);
+
+		constexpr uint16_t fullMask{ UINT16_MAX };
+		for (int cellY{ minCellY }; cellY <= maxCellY; ++cellY)
+		{
+			for (int cellX{ minCellX }; cellX <= maxCellX; ++cellX)
+			{
+				Cell& cell = m_vCells[cellY * m_Width + cellX];
+				// Can't make this cell any closer
+				if (maxDepth >= cell.depth) continue;
+
+				uint16_t mask{};
+				for (int sampleIndex{}; sampleIndex < CellSamples * CellSamples; ++sampleIndex)
+				{
+					const FixedPoint sample{
+						(cellX * CellSamples + sampleIndex % CellSamples) * SubSampleSteps + SubSampleSteps / 2,
+						(cellY * CellSamples + sampleIndex / CellSamples) * SubSampleSteps + SubSampleSteps / 2 };
+					if (EdgeFunction(f0, f1, sample) * windingSign >= 0
+						and EdgeFunction(f1, f2, sample) * windingSign >= 0
+						and EdgeFunction(f2, f0, sample) * windingSign >= 0)
+						mask |= uint16_t(1u << sampleIndex);
+				}
+				if (mask == 0) continue;
+
+				if (mask == fullMask)
+				{
+					cell.depth = maxDepth;
+					continue;
+				}
+
+				cell.workingMask |= mask;
+				cell.workingDepth = std::max(cell.workingDepth, maxDepth);
+				if (cell.workingMask == fullMask)
+				{
+					cell.depth = std::min(cell.depth, cell.workingDepth);
+					cell.workingMask = 0;
+					cell.workingDepth = 0.f;
+				}
+			}
+		}
+	}
+
+	bool OcclusionBuffer::IsOccluded(const Vector2& ndcMin, const Vector2& ndcMax, float minDepth) const
+	{
+		// NDC y points up, cell rows go down
+		const int minX = std::clamp(int(std::floor((1.f + ndcMin.x) * 0.5f * m_Width)), 0, m_Width - 1);
+		const int maxX = std::clamp(int(std::floor((1.f + ndcMax.x) * 0.5f * m_Width)), 0, m_Width - 1);
+		const int minY = std::clamp(int(std::floor((1.f - ndcMax.y) * 0.5f * m_Height)), 0, m_Height - 1);
+		const int maxY = std::clamp(int(std::floor((1.f - ndcMin.y) * 0.5f * m_Height)), 0, m_Height - 1);
+
+		for (int cellY{ minY }; cellY <= maxY; ++cellY)
+		{
+			for (int cellX{ minX }; cellX <= maxX; ++cellX)
+			{
+				if (minDepth <= m_vCells[cellY * m_Width + cellX].depth) return false;
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace dae
+{
+	struct Vector2;
+	struct Vector4;
+
+	// Small depth buffer that only holds occluders, used to skip whole meshes before their vertices are transformed.
+	// Conservative, every cell keeps a mask of 4x4 samples so triangles that share an edge can cover a cell together,
+	// its depth is only lowered once all samples are covered, to the farthest depth of the triangles that covered them
+	class OcclusionBuffer final
+	{
+	public:
+		static constexpr int CellSamples{ 4 };
+
+		OcclusionBuffer(int width, int height);
+
+		void Clear();
+
+		// Positions in NDC, triangles that cross the near plane are ignored
+		void RasterizeOccluder(const Vector4& v0, const Vector4& v1, const Vector4& v2);
+
+		// True if every cell within the NDC rectangle is closer than minDepth
+		bool IsOccluded(const Vector2& ndcMin, const Vector2& ndcMax, float minDepth) const;
+
+	private:
+		struct Cell
+		{
+			float depth{ 1.f };
+			// Samples covered since the depth was last lowered, and the farthest depth among them
+			uint16_t workingMask{};
+			float workingDepth{};
+		};
+
+		int m_Width{};
+		int m_Height{};
+
+		std::vector<Cell> m_vCells{};
+	};
+}
@@ -0,0 +1,170 @@
+#include "Presenter.h"
+#include "SDL.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dae
+{
+	Presenter::Presenter(SDL_Window* pWindow, int width, int height, uint32_t bufferCount) :
+		m_pWindow{ pWindow }
+	{
+		m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
+		m_vBuffers.resize(std::max(bufferCount, 1u));
+		for (SDL_Surface*& pBuffer : m_vBuffers)
+			pBuffer = SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0);
+
+		m_MillisecondsPerCount = 1000.f / float(SDL_GetPerformanceFrequency());
+		m_PresentThread = std::thread(&Presenter::PresentLoop, this);
+	}
+
+	Presenter::~Presenter()
+	{
+		WaitUntilPresented();
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_FrameQueued.notify_one();
+		m_PresentThread.join();
+
+		for (SDL_Surface* pBuffer : m_vBuffers)
+			SDL_FreeSurface(pBuffer);
+	}
+
+	SDL_Surface* Presenter::AcquireBackBuffer()
+	{
+		// The last copy is shown now, the window can only be updated from this thread
+		UpdateWindow();
+
+		const uint64_t waitStart = SDL_GetPerformanceCounter();
+		std::unique_lock lock{ m_Mutex };
+		// The buffer at m_AcquireIndex is free as long as not every buffer is queued
+		m_FramePresented.wait(lock, [this] { return m_QueuedCount < m_vBuffers.size(); });
+
+		++m_AcquireCount;
+		m_AcquireWaitSum += SDL_GetPerformanceCounter() - waitStart;
+		return m_vBuffers[m_AcquireIndex];
+	}
+
+	void Presenter::Present()
+	{
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_AcquireIndex = (m_AcquireIndex + 1) % uint32_t(m_vBuffers.size());
+			++m_QueuedCount;
+		}
+		m_FrameQueued.notify_one();
+	}
+
+	void Presenter::UpdateWindow()
+	{
+		{
+			std::lock_guard lock{ m_Mutex };
+			if (!m_HasCopiedFrame) return;
+		}
+		const uint64_t updateStart = SDL_GetPerformanceCounter();
+		SDL_UpdateWindowSurface(m_pWindow);
+		const uint64_t updateEnd = SDL_GetPerformanceCounter();
+
+		std::lock_guard lock{ m_Mutex };
+		m_HasCopiedFrame = false;
+		m_FrameQueued.notify_one();
+		++m_PresentCount;
+		m_PresentTimeSum += m_LastCopyTime + (updateEnd - updateStart);
+		if (m_LastPresentTime != 0)
+		{
+			const uint64_t interval = updateEnd - m_LastPresentTime;
+			m_MinInterval = m_IntervalCount == 0 ? interval : std::min(m_MinInterval, interval);
+			m_MaxInterval = std::max(m_MaxInterval, interval);
+			m_IntervalSum += double(interval);
+			m_IntervalSquareSum += double(interval) * double(interval);
+			++m_IntervalCount;
+		}
+		m_LastPresentTime = updateEnd;
+	}
+
+	uint32_t Presenter::GetAcquiredBufferIndex() const
+	{
+		std::lock_guard lock{ m_Mutex };
+		return m_AcquireIndex;
+	}
+
+	const SDL_PixelFormat* Presenter::GetPixelFormat() const
+	{
+		return m_vBuffers[0]->format;
+	}
+
+	void Presenter::WaitUntilPresented()
+	{
+		// The present thread needs this thread to show every copy before it makes the next one
+		std::unique_lock lock{ m_Mutex };
+		while (m_QueuedCount > 0 or m_HasCopiedFrame)
+		{
+			m_FramePresented.wait(lock, [this] { return m_QueuedCount == 0 or m_HasCopiedFrame; });
+			lock.unlock();
+			UpdateWindow();
+			lock.lock();
+		}
+	}
+
+	FramePacingStats Presenter::GetPacingStats() const
+	{
+		std::lock_guard lock{ m_Mutex };
+		FramePacingStats stats{};
+		stats.frameCount = m_PresentCount;
+		if (m_IntervalCount > 0)
+		{
+			const double averageInterval = m_IntervalSum / m_IntervalCount;
+			const double variance = std::max(m_IntervalSquareSum / m_IntervalCount - averageInterval * averageInterval, 0.0);
+			stats.averageInterval = float(averageInterval) * m_MillisecondsPerCount;
+			stats.minInterval = float(m_MinInterval) * m_MillisecondsPerCount;
+			stats.maxInterval = float(m_MaxInterval) * m_MillisecondsPerCount;
+			stats.intervalDeviation = float(std::sqrt(variance)) * m_MillisecondsPerCount;
+		}
+		if (m_PresentCount > 0) stats.averagePresentTime = float(m_PresentTimeSum) / m_PresentCount * m_MillisecondsPerCount;
+		if (m_AcquireCount > 0) stats.averageAcquireWait = float(m_AcquireWaitSum) / m_AcquireCount * m_MillisecondsPerCount;
+		return stats;
+	}
+
+	void Presenter::ResetPacingStats()
+	{
+		std::lock_guard lock{ m_Mutex };
+		// The next present starts a new interval
+		m_LastPresentTime = 0;
+		m_PresentCount = 0;
+		m_IntervalCount = 0;
+		m_IntervalSum = 0.0;
+		m_IntervalSquareSum = 0.0;
+		m_MinInterval = 0;
+		m_MaxInterval = 0;
+		m_PresentTimeSum = 0;
+		m_AcquireCount = 0;
+		m_AcquireWaitSum = 0;
+	}
+
+	void Presenter::PresentLoop()
+	{
+		const uint32_t bufferCount = uint32_t(m_vBuffers.size());
+		std::unique_lock lock{ m_Mutex };
+		while (true)
+		{
+			// The destructor waits until everything in line was shown before it stops the thread
+			m_FrameQueued.wait(lock, [this] { return (m_QueuedCount > 0 and !m_HasCopiedFrame) or m_IsStopping; });
+			if (m_IsStopping) return;
+
+			// The renderer only ever touches the buffer at m_AcquireIndex, so the oldest queued one is ours until it is released
+			SDL_Surface* pBuffer = m_vBuffers[(m_AcquireIndex + bufferCount - m_QueuedCount) % bufferCount];
+			lock.unlock();
+			const uint64_t copyStart = SDL_GetPerformanceCounter();
+			SDL_BlitSurface(pBuffer, nullptr, m_pFrontBuffer, nullptr);
+			const uint64_t copyEnd = SDL_GetPerformanceCounter();
+			lock.lock();
+
+			m_LastCopyTime = copyEnd - copyStart;
+			m_HasCopiedFrame = true;
+			--m_QueuedCount;
+			m_FramePresented.notify_all();
+		}
+	}
+}
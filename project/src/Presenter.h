@@ -0,0 +1,96 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct SDL_Window;
+struct SDL_Surface;
+struct SDL_PixelFormat;
+
+namespace dae
+{
+	// How evenly the frames reached the window, all times in milliseconds
+	struct FramePacingStats
+	{
+		uint32_t frameCount{};
+		float averageInterval{};	// Between two presents
+		float minInterval{};
+		float maxInterval{};
+		float intervalDeviation{};	// Standard deviation of the interval, zero for perfectly even frames
+		float averagePresentTime{};	// Blit on the present thread and window update
+		float averageAcquireWait{};	// Time the renderer waited for a free back buffer
+	};
+
+	// Ring of back buffers with a thread of its own that copies them into the window surface. The renderer draws into one buffer
+	// while the ones before it wait in line or are being copied, it only blocks once all the others are still in use.
+	// Two buffers is double buffering, three lets the renderer run a whole frame ahead of a slow present.
+	// SDL only allows updating the window from the thread that made it (Cocoa enforces it), so the present thread only copies
+	// and the render thread shows the copy in UpdateWindow. The next copy waits until then, so no frame is skipped.
+	// Everything has to be called on the thread that made the window
+	class Presenter final
+	{
+	public:
+		Presenter(SDL_Window* pWindow, int width, int height, uint32_t bufferCount = 3);
+		// Presents the frames still in line first, on the thread that made the window as well
+		~Presenter();
+
+		Presenter(const Presenter&) = delete;
+		Presenter(Presenter&&) noexcept = delete;
+		Presenter& operator=(const Presenter&) = delete;
+		Presenter& operator=(Presenter&&) noexcept = delete;
+
+		// The next buffer of the ring, waits until the present thread is done with it
+		SDL_Surface* AcquireBackBuffer();
+		// Queues the buffer acquired last
+		void Present();
+		// Shows the frame copied last if it wasn't shown yet, AcquireBackBuffer already does it every frame
+		void UpdateWindow();
+		// Waits until every queued frame reached the window, the buffers can then be read safely
+		void WaitUntilPresented();
+
+		uint32_t GetBufferCount() const { return uint32_t(m_vBuffers.size()); }
+		// Position in the ring of the buffer acquired last
+		uint32_t GetAcquiredBufferIndex() const;
+		// Shared by all buffers
+		const SDL_PixelFormat* GetPixelFormat() const;
+		FramePacingStats GetPacingStats() const;
+		void ResetPacingStats();
+
+	private:
+		void PresentLoop();
+
+		SDL_Window* m_pWindow{};
+		SDL_Surface* m_pFrontBuffer{};
+		std::vector<SDL_Surface*> m_vBuffers{};
+
+		// The queued frames are the m_QueuedCount buffers right before m_AcquireIndex, the oldest one is presented first
+		uint32_t m_AcquireIndex{};
+		uint32_t m_QueuedCount{};
+		bool m_IsStopping{};
+		mutable std::mutex m_Mutex{};
+		std::condition_variable m_FrameQueued{};
+		std::condition_variable m_FramePresented{};
+
+		// Pacing, in performance counter ticks
+		float m_MillisecondsPerCount{};
+		uint64_t m_LastPresentTime{};
+		uint32_t m_PresentCount{};
+		uint32_t m_IntervalCount{};
+		double m_IntervalSum{};
+		double m_IntervalSquareSum{};
+		uint64_t m_MinInterval{};
+		uint64_t m_MaxInterval{};
+		uint64_t m_PresentTimeSum{};
+		uint32_t m_AcquireCount{};
+		uint64_t m_AcquireWaitSum{};
+
+		// Set once a frame is in the window surface, cleared when it was shown. The present thread only copies while it is
+		// cleared and the render thread only shows while it is set, so they never touch the window surface at once
+		bool m_HasCopiedFrame{};
+		uint64_t m_LastCopyTime{};
+
+		std::thread m_PresentThread{};
+	};
+}
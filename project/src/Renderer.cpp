@@ -4,285 +4,1430 @@
 
 //Project includes
 #include "Renderer.h"
+#include "HiZBuffer.h"
+#include "JobSystem.h"
+#include "OcclusionBuffer.h"
+#include "Presenter.h"
+#include "SceneFile.h"
 #include "Maths.h"
 #include "Texture.h"
 #include "Utils.h"
 
-#include <execution>
-#include <future>
+#include <numeric>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 #include <thread>
+#include <type_traits>
 
 using namespace dae;
 
-Renderer::Renderer(SDL_Window* pWindow) :
+namespace
+{
+#if defined(__SSE2__) || defined(_M_X64)
+	// Saturating packs of the first three lanes, already scaled to 0..255, down to one byte per channel with red in the lowest one
+	uint32_t PackChannelBytes(__m128 scaled)
+	{
+		const __m128i words = _mm_packs_epi32(_mm_cvttps_epi32(scaled), _mm_setzero_si128());
+		return uint32_t(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+	}
+#endif
+
+	// Coverage and interpolated depths of one pixel. Every instantiation of the raster loop calls this same out of line copy,
+	// so the compiler can't contract its math into FMAs differently per pass, the depth pre-pass relies on the exact same
+	// depth coming out of both of its passes. Returns false when the pixel isn't covered or lies outside the depth range
+#if defined(_MSC_VER)
+	__declspec(noinline)
+#else
+	[[gnu::noinline]]
+#endif
+	bool CalculatePixelDepth(const Vector4& position0, const Vector4& position1, const Vector4& position2, int px, int py, float invArea,
+		Vector3& barycentricCoords, float& zBufferValue, float& wInterpolated)
+	{
+		// Calculate the barycentric coordinates of that pixel in relationship to the triangle,
+		// these barycentric coordinates CAN be invalid (point outside triangle)
+		const Vector2 pixelCoord = Vector2(px + 0.5f, py + 0.5f);
+		barycentricCoords = CalculateBarycentricCoordinates(position0.GetXY(), position1.GetXY(), position2.GetXY(), pixelCoord, invArea);
+
+		// Check if our barycentric coordinates are valid, if not, skip to the next pixel
+		// The facing was already dealt with in SetupTriangle
+		if (!AreBarycentricValid(barycentricCoords, false, false)) return false;
+
+		// Now we interpolated both our Z and W depths
+		zBufferValue = InterpolateDepth(position0.z, position1.z, position2.z, barycentricCoords);
+		wInterpolated = InterpolateDepth(position0.w, position1.w, position2.w, barycentricCoords);
+		if (zBufferValue < 0 or zBufferValue > 1) return false; // if z-depth is outside of frustum, skip to next pixel
+		if (wInterpolated < 0) return false; // if w-depth is negative (behind camera), skip to next pixel
+		return true;
+	}
+}
+
+Renderer::Renderer(SDL_Window* pWindow, const std::string& sceneFile) :
 	m_pWindow(pWindow)
 {
 	// Initialize
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
 	m_AspectRatio = float(m_Width) / m_Height;
 
-	// Create Buffers
-	m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
-	m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
-	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
+	// Create Buffers, the back buffers belong to the presenter and change every frame
+	m_upPresenter = std::make_unique<Presenter>(pWindow, m_Width, m_Height, BackBufferCount);
+	const SDL_PixelFormat* pPixelFormat = m_upPresenter->GetPixelFormat();
+	m_PixelLayout = { pPixelFormat->Rshift, pPixelFormat->Gshift, pPixelFormat->Bshift, pPixelFormat->Amask };
 
 	m_pDepthBufferPixels = new float[m_Width * m_Height];
+	m_upHiZBuffer = std::make_unique<HiZBuffer>(m_Width, m_Height, m_pDepthBufferPixels);
+	m_upOcclusionBuffer = std::make_unique<OcclusionBuffer>(m_Width / OcclusionBufferScale, m_Height / OcclusionBufferScale);
+	m_vGBuffer.resize(m_Width * m_Height);
+	m_vVisibilityBuffer.resize(m_Width * m_Height);
+	m_vHdrBuffer.resize(m_Width * m_Height);
+
+	// Cleared on first touch, every back buffer remembers which of its tiles still hold the clear color
+	m_TileCountX = (m_Width + HiZBuffer::TileSize - 1) / HiZBuffer::TileSize;
+	m_TileCountY = (m_Height + HiZBuffer::TileSize - 1) / HiZBuffer::TileSize;
+	m_vTileCleared.resize(m_TileCountX * m_TileCountY);
+	m_vClearColorTiles.resize(m_upPresenter->GetBufferCount(), std::vector<uint8_t>(m_TileCountX * m_TileCountY));
+	m_vTileBins.resize(m_TileCountX * m_TileCountY);
+
+	// One worker per hardware thread, the render thread is the last one
+	m_upJobSystem = std::make_unique<JobSystem>();
+
+	// Camera, light, meshes and instances
+	LoadScene(sceneFile);
+}
 
-	// Initialize Camera
-	m_Camera.Initialize(45.f, { 0.f, 5.f, -64.f }, m_AspectRatio, 0.1f, 100.f);
+Renderer::~Renderer()
+{
+	delete[] m_pDepthBufferPixels;
+}
 
-	// Initialize Meshes
-	m_vMeshes.resize(1);
+uint32_t dae::Renderer::AddMesh(Mesh&& mesh)
+{
+	return AddMesh(std::make_shared<Mesh>(std::move(mesh)));
+}
 
-	// MESH 01
-	Utils::ParseOBJ("resources/vehicle.obj", m_vMeshes[0].vertices, m_vMeshes[0].indices, m_vMeshes[0].vertexCounter);
-	m_vMeshes[0].primitiveTopology = PrimitiveTopology::TriangleList;
+uint32_t dae::Renderer::AddMesh(const MeshHandle& mesh)
+{
+	// A mesh the resource manager handed out twice is still drawn as one
+	const auto meshIt = std::find(m_vMeshes.begin(), m_vMeshes.end(), mesh);
+	if (meshIt != m_vMeshes.end()) return uint32_t(meshIt - m_vMeshes.begin());
 
-	m_vMeshes[0].LoadDiffuseTexture("resources/vehicle_diffuse.png");
-	m_vMeshes[0].LoadNormalMap("resources/vehicle_normal.png");
-	m_vMeshes[0].LoadGlossinessMap("resources/vehicle_gloss.png");
-	m_vMeshes[0].LoadSpecularMap("resources/vehicle_specular.png");
+	// Meshes that skipped the preprocessing of the resource manager get their meshlets here, before any frame reads them
+	for (MeshLod& lod : mesh->lods)
+	{
+		if (lod.meshlets.empty()) BuildMeshlets(mesh->vertices, lod);
+	}
+	m_vMeshes.emplace_back(mesh);
+	return uint32_t(m_vMeshes.size() - 1);
 }
 
-Renderer::~Renderer()
+uint32_t dae::Renderer::AddMeshInstances(uint32_t mesh, const std::vector<Matrix>& worldMatrices, const ColorRGB& tint)
 {
-	delete[] m_pDepthBufferPixels;
+	const uint32_t firstInstance = uint32_t(m_vInstances.size());
+	for (const Matrix& worldMatrix : worldMatrices)
+	{
+		MeshInstance& instance = m_vInstances.emplace_back();
+		instance.mesh = mesh;
+		instance.worldMatrix = worldMatrix;
+		instance.tint = tint;
+		m_Scene.SetInstance(m_Scene.AddNode({}, Scene::NoParent, worldMatrix), uint32_t(m_vInstances.size() - 1));
+	}
+	return firstInstance;
+}
+
+void dae::Renderer::LoadScene(const std::string& path)
+{
+	SceneDescription description{};
+	if (!ParseSceneFile(path, description)) throw std::runtime_error("Failed to load scene");
+
+	const SceneDescription::CameraEntry& camera = description.camera;
+	m_Camera.Initialize(camera.fovAngle, camera.origin, m_AspectRatio, camera.near, camera.far);
+	m_DirectionToLight = -description.lightDirection.Normalized();
+	m_Ambient = description.ambient;
+
+	// Every mesh and texture is read and decoded on its own task. Scene files that use the same OBJ or PNG share it
+	// through the resource manager
+	TaskGroup loadGroup{};
+	std::vector<MeshHandle> meshes(description.meshes.size());
+	for (size_t meshIndex{}; meshIndex < meshes.size(); ++meshIndex)
+	{
+		m_upJobSystem->Run(loadGroup, [&, meshIndex] { meshes[meshIndex] = m_ResourceManager.LoadMesh(description.meshes[meshIndex].path); });
+	}
+
+	std::vector<std::array<TextureHandle, 4>> materialTextures(description.materials.size());
+	for (size_t materialIndex{}; materialIndex < materialTextures.size(); ++materialIndex)
+	{
+		const SceneDescription::MaterialEntry& material = description.materials[materialIndex];
+		const std::array<const std::string*, 4> texturePaths{ &material.diffusePath, &material.normalPath, &material.glossPath, &material.specularPath };
+		for (size_t textureIndex{}; textureIndex < texturePaths.size(); ++textureIndex)
+		{
+			if (texturePaths[textureIndex]->empty()) continue;
+			TextureHandle& texture = materialTextures[materialIndex][textureIndex];
+			m_upJobSystem->Run(loadGroup, [&, pPath = texturePaths[textureIndex]] { texture = m_ResourceManager.LoadTexture(*pPath); });
+		}
+	}
+	m_upJobSystem->Wait(loadGroup);
+
+	// The cull mode and textures live on the mesh, but the resource manager hands the same mesh to every line that loads
+	// the same OBJ. The first line to use it sets them, a line that wants other ones gets a copy of its own
+	std::vector<std::pair<const Mesh*, MeshHandle>> meshCopies{};
+	std::vector<uint32_t> meshIndices{};
+	for (size_t meshIndex{}; meshIndex < meshes.size(); ++meshIndex)
+	{
+		const SceneDescription::MeshEntry& meshEntry = description.meshes[meshIndex];
+		const std::array<TextureHandle, 4> textures = meshEntry.material >= 0 ? materialTextures[meshEntry.material] : std::array<TextureHandle, 4>{};
+		const auto hasSettings = [&](const Mesh& mesh)
+			{
+				return mesh.cullMode == meshEntry.cullMode and mesh.m_pDiffuseTxt == textures[0] and mesh.m_pNormalTxt == textures[1]
+					and mesh.m_pGlossTxt == textures[2] and mesh.m_pSpecularTxt == textures[3];
+			};
+		const auto applySettings = [&](Mesh& mesh)
+			{
+				mesh.cullMode = meshEntry.cullMode;
+				mesh.m_pDiffuseTxt = textures[0];
+				mesh.m_pNormalTxt = textures[1];
+				mesh.m_pGlossTxt = textures[2];
+				mesh.m_pSpecularTxt = textures[3];
+			};
+
+		MeshHandle mesh = meshes[meshIndex];
+		const bool isInUse = std::find(m_vMeshes.begin(), m_vMeshes.end(), mesh) != m_vMeshes.end();
+		if (!isInUse)
+		{
+			applySettings(*mesh);
+		}
+		else if (!hasSettings(*mesh))
+		{
+			const auto copyIt = std::find_if(meshCopies.begin(), meshCopies.end(), [&](const std::pair<const Mesh*, MeshHandle>& copy)
+				{
+					return copy.first == mesh.get() and hasSettings(*copy.second);
+				});
+			if (copyIt != meshCopies.end())
+			{
+				mesh = copyIt->second;
+			}
+			else
+			{
+				MeshHandle meshCopy = std::make_shared<Mesh>(*mesh);
+				applySettings(*meshCopy);
+				meshCopies.emplace_back(mesh.get(), meshCopy);
+				mesh = meshCopy;
+			}
+		}
+		meshIndices.emplace_back(AddMesh(mesh));
+	}
+
+	// The description lists parents first as well, so its indices only need the offset of the nodes already in the scene
+	const uint32_t firstNode = uint32_t(m_Scene.GetNodeCount());
+	for (const SceneDescription::NodeEntry& nodeEntry : description.nodes)
+	{
+		const uint32_t parent = nodeEntry.parent < 0 ? Scene::NoParent : firstNode + nodeEntry.parent;
+		const uint32_t node = m_Scene.AddNode(nodeEntry.name, parent, nodeEntry.localMatrix);
+		m_Scene.SetSpinSpeed(node, nodeEntry.spinSpeed);
+		if (nodeEntry.mesh < 0) continue;
+
+		MeshInstance& instance = m_vInstances.emplace_back();
+		instance.mesh = meshIndices[nodeEntry.mesh];
+		instance.tint = nodeEntry.tint;
+		m_Scene.SetInstance(node, uint32_t(m_vInstances.size() - 1));
+	}
+	m_Scene.UpdateWorldMatrices(m_vInstances, m_vMovedInstances);
 }
 
 void Renderer::Update(Timer* pTimer)
 {
 	m_Camera.Update(pTimer);
 
-	const float rotationSpeedRadians = 1;
-	if(m_RotateMesh) m_vMeshes[0].worldMatrix = Matrix::CreateRotationY(rotationSpeedRadians * pTimer->GetElapsed())
-													* m_vMeshes[0].worldMatrix;
+	// Spinning nodes turn around their own origin, only the changed world matrices are recomputed
+	if (m_RotateMesh) m_Scene.Animate(pTimer->GetElapsed());
+	m_Scene.UpdateWorldMatrices(m_vInstances, m_vMovedInstances);
 }
 
 void Renderer::Render()
+{
+	// Nothing prepared yet, the front end of this frame has to finish before it can be drawn
+	if (!m_PipelineFrames or !m_HasPreparedFrame)
+	{
+		PrepareFrame();
+		HandOverFrame();
+		DrawFrame();
+		m_HasPreparedFrame = m_PipelineFrames;
+		return;
+	}
+
+	// The front end of this frame runs on the job system while the back end draws the one prepared before, so what is
+	// shown is one frame behind. Update already ran, so both only read the camera and the world matrices
+	TaskGroup prepareGroup{};
+	m_upJobSystem->Run(prepareGroup, [this] { PrepareFrame(); });
+	DrawFrame();
+	m_upJobSystem->Wait(prepareGroup);
+	HandOverFrame();
+}
+
+void dae::Renderer::PrepareFrame()
+{
+	// Only the visible instances are sorted, closest first so their depth rejects as much of the rest as possible
+	UpdateInstanceBvh();
+	CullInstances();
+	SortInstancesFrontToBack();
+	SelectInstanceLods();
+}
+
+void dae::Renderer::HandOverFrame()
+{
+	m_RenderViewMatrix = m_Camera.viewMatrix;
+	m_RenderProjectionMatrix = m_Camera.projectionMatrix;
+	m_RenderCameraOrigin = m_Camera.origin;
+
+	// The front end builds the order from scratch every frame, so the old one can be reused for it
+	std::swap(m_vRenderOrder, m_vInstanceOrder);
+	for (uint32_t instanceIndex : m_vRenderOrder)
+	{
+		MeshInstance& instance = m_vInstances[instanceIndex];
+		instance.renderWorldMatrix = instance.worldMatrix;
+		instance.renderLod = instance.lod;
+	}
+}
+
+void dae::Renderer::DrawFrame()
 {
 	// @START
-	SDL_FillRect(m_pBackBuffer, NULL, 0x646464);
-	std::fill(&m_pDepthBufferPixels[0], &m_pDepthBufferPixels[m_Width * m_Height], 1);
+	m_pBackBuffer = m_upPresenter->AcquireBackBuffer();
+	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
+	// The color, depth and visibility buffers are only cleared one tile at a time, when something is drawn in it
+	std::fill(m_vTileCleared.begin(), m_vTileCleared.end(), uint8_t(false));
+	m_upHiZBuffer->Clear(1);
 
 	// Lock BackBuffer
 	SDL_LockSurface(m_pBackBuffer);
 
-	// predefine a triangle we can reuse
-	std::array<Vertex_Out, 3> triangleNDC{};
-	std::array<Vertex_Out, 3> triangleRasterVertices{};
-	for (int triangleMeshIndex{}; triangleMeshIndex < m_vMeshes.size(); ++triangleMeshIndex)
+	// Wireframes are only drawn by the forward path, and so are scenes too large for the visibility IDs
+	m_DrawRenderPath = m_DrawWireFrames ? RenderPath::Forward : m_CurrentRenderPath;
+	if ((m_DrawRenderPath == RenderPath::Deferred or m_DrawRenderPath == RenderPath::VisibilityBuffer) and !CanPackVisibilityIds())
+		m_DrawRenderPath = RenderPath::Forward;
+	// The depth visualization shows the stored values as they are, tonemapping would bend the ramp
+	m_ResolveHdr = m_UseHdr and !m_DepthBufferVisualization;
+	switch (m_DrawRenderPath)
 	{
-		Mesh& currentMesh = m_vMeshes[triangleMeshIndex];
+	case dae::Renderer::RenderPath::Deferred:
+		RenderVisibilityPasses<RenderPath::Deferred>();
+		break;
+	case dae::Renderer::RenderPath::VisibilityBuffer:
+		RenderVisibilityPasses<RenderPath::VisibilityBuffer>();
+		break;
+	case dae::Renderer::RenderPath::DepthPrePass:
+		RenderDepthPrePass();
+		if (m_ResolveHdr) ResolveHdrBuffer();
+		break;
+	case dae::Renderer::RenderPath::Forward:
+	default:
+		RenderForward();
+		if (m_ResolveHdr) ResolveHdrBuffer();
+		break;
+	}
+	ClearUntouchedTiles();
 
-		int indexJump = 0;
-		int triangleCount = 0;
-		bool triangleStripMethod = false;
+	// @END
+	SDL_UnlockSurface(m_pBackBuffer);
+	// The present thread copies it to the window, the next frame can already start on another buffer
+	m_upPresenter->Present();
+}
 
-		// Determine the triangle count and index jump depending on the PrimitiveTopology
-		if (m_vMeshes[triangleMeshIndex].primitiveTopology == PrimitiveTopology::TriangleList)
+void dae::Renderer::RenderForward()
+{
+	if (m_DrawWireFrames)
+	{
+		ForEachInstanceBatch(VertexStage::All, [&](MeshInstance& instance, uint32_t)
+			{
+				RenderMeshWireFrames(instance);
+			}, [] {});
+		return;
+	}
+
+	// Pick the pipeline variant for the current settings once, instead of branching on them for every pixel
+	const RasterizeBinsFunction shadeBins = SelectShadeBinsFunction<DepthTest::LessEqual>();
+	ForEachInstanceBatch(VertexStage::All, [&](MeshInstance& instance, uint32_t instanceIndex)
 		{
-			indexJump = 3;
-			triangleCount = m_vMeshes[triangleMeshIndex].indices.size() / 3;
-			triangleStripMethod = false;
-		}
-		else if (m_vMeshes[triangleMeshIndex].primitiveTopology == PrimitiveTopology::TriangleStrip)
+			BinTriangles<DepthTest::LessEqual>(instance, instanceIndex, shadeBins);
+		}, [&] { (this->*shadeBins)(); });
+}
+
+void dae::Renderer::RenderDepthPrePass()
+{
+	// Depth pass, only the positions are transformed and rasterized
+	ForEachInstanceBatch(VertexStage::Positions, [&](MeshInstance& instance, uint32_t instanceIndex)
 		{
-			indexJump = 1;
-			triangleCount = m_vMeshes[triangleMeshIndex].indices.size() - 2;
-			triangleStripMethod = true;
+			BinTriangles<DepthTest::LessEqual>(instance, instanceIndex, &Renderer::RasterizeBinsDepth);
+		}, [&] { RasterizeBinsDepth(); });
+
+	// Shading pass, only the fragments that ended up in the depth buffer get shaded, the meshlets culled above stay culled
+	ProjectInstances(0, m_vRenderOrder.size(), VertexStage::Attributes);
+	const RasterizeBinsFunction shadeBins = SelectShadeBinsFunction<DepthTest::Equal>();
+	for (uint32_t instanceIndex : m_vRenderOrder)
+	{
+		BinTriangles<DepthTest::Equal>(m_vInstances[instanceIndex], instanceIndex, shadeBins);
+	}
+	(this->*shadeBins)();
+}
+
+void dae::Renderer::RasterizeBinsDepth()
+{
+	RasterizeBins<DepthTest::LessEqual>([&](const BinnedTriangle& triangle, int tileX, int tileY)
+		{
+			return RasterizeTriangleTile<DepthTest::LessEqual>(triangle, tileX, tileY, [](int, const Vector3&, float, float) {});
+		});
+}
+
+template<Renderer::RenderPath Path>
+void dae::Renderer::RenderVisibilityPasses()
+{
+	// Raster pass, only depth and which triangle covers the pixel end up in the buffers, ClearTile empties them
+	ForEachInstanceBatch(VertexStage::All, [&](MeshInstance& instance, uint32_t instanceIndex)
+		{
+			BinTriangles<DepthTest::LessEqual>(instance, instanceIndex, &Renderer::RasterizeBinsVisibility<Path>);
+		}, [&] { RasterizeBinsVisibility<Path>(); });
+
+	// Shading pass, exactly once for every covered pixel
+	(this->*SelectShadePassFunction<Path>())();
+}
+
+template<Renderer::DepthTest Test>
+Renderer::RasterizeBinsFunction dae::Renderer::SelectShadeBinsFunction() const
+{
+	// The depth buffer visualization overwrites the shaded color, so it doesn't shade at all
+	if (m_DepthBufferVisualization) return &Renderer::ShadeBins<Test, ShadingMode::Combined, false, true>;
+
+	switch (m_CurrentShadingMode)
+	{
+	case dae::Renderer::ShadingMode::ObservedArea:
+		return m_UseNormalMap	? &Renderer::ShadeBins<Test, ShadingMode::ObservedArea, true, false>
+								: &Renderer::ShadeBins<Test, ShadingMode::ObservedArea, false, false>;
+	case dae::Renderer::ShadingMode::Diffuse:
+		// The diffuse color doesn't depend on the normal
+		return &Renderer::ShadeBins<Test, ShadingMode::Diffuse, false, false>;
+	case dae::Renderer::ShadingMode::Specular:
+		return m_UseNormalMap	? &Renderer::ShadeBins<Test, ShadingMode::Specular, true, false>
+								: &Renderer::ShadeBins<Test, ShadingMode::Specular, false, false>;
+	case dae::Renderer::ShadingMode::Combined:
+	default:
+		return m_UseNormalMap	? &Renderer::ShadeBins<Test, ShadingMode::Combined, true, false>
+								: &Renderer::ShadeBins<Test, ShadingMode::Combined, false, false>;
+	}
+}
+
+bool dae::Renderer::CanPackVisibilityIds() const
+{
+	if (m_vInstances.size() > MaxVisibilityInstances) return false;
+	for (const MeshHandle& mesh : m_vMeshes)
+	{
+		for (const MeshLod& lod : mesh->lods)
+		{
+			if (uint32_t(GetTriangleCount(lod)) > VisibilityTriangleMask) return false;
 		}
+	}
+	return true;
+}
 
-		// Project the entire mesh to NDC coordinates
-		ProjectMeshToNDC(currentMesh);
+int dae::Renderer::GetTriangleCount(const MeshLod& lod) const
+{
+	// Determine the triangle count depending on the PrimitiveTopology
+	if (lod.primitiveTopology == PrimitiveTopology::TriangleList)	return int(lod.indices.size() / 3);
+	if (lod.primitiveTopology == PrimitiveTopology::TriangleStrip)	return std::max(int(lod.indices.size()) - 2, 0);
+	return 0;
+}
 
-		// Loop over all the triangles
-		for (int triangleIndex{}; triangleIndex < triangleCount; ++triangleIndex)
+template<typename TriangleFunction>
+void dae::Renderer::ForEachTriangle(const MeshInstance& instance, TriangleFunction&& triangleFunction) const
+{
+	const MeshLod& lod = m_vMeshes[instance.mesh]->lods[instance.renderLod];
+
+	// Only the meshlets that survived culling, front to back while depth sorting is on, the triangles within a meshlet stay in index order
+	for (uint32_t meshletIndex : instance.visibleMeshlets)
+	{
+		const Meshlet& meshlet = lod.meshlets[meshletIndex];
+		for (uint32_t triangleIndex{ meshlet.firstTriangle }; triangleIndex < meshlet.firstTriangle + meshlet.triangleCount; ++triangleIndex)
+			triangleFunction(int(triangleIndex));
+	}
+}
+
+uint16_t dae::Renderer::QuantizeViewDepth(float viewDepth) const
+{
+	const float depth01 = std::clamp((viewDepth - m_Camera.near) / (m_Camera.far - m_Camera.near), 0.f, 1.f);
+	return static_cast<uint16_t>(depth01 * UINT16_MAX);
+}
+
+void dae::Renderer::SortInstancesFrontToBack()
+{
+	if (!m_SortFrontToBack) return;
+
+	// Coarse, the view depth of the instance origin is all we know before the vertices are transformed
+	m_vInstanceSortKeys.resize(m_vInstances.size());
+	m_upJobSystem->ParallelFor(uint32_t(m_vInstanceOrder.size()), InstanceSortGrain, [&](uint32_t orderIndex)
 		{
-			uint32_t indexPos0 = currentMesh.indices[indexJump * triangleIndex + 0];
-			uint32_t indexPos1 = currentMesh.indices[indexJump * triangleIndex + 1];
-			uint32_t indexPos2 = currentMesh.indices[indexJump * triangleIndex + 2];
-			// Skip if duplicate indices
-			if (indexPos0 == indexPos1 or indexPos0 == indexPos2 or indexPos1 == indexPos2) continue;
-			// If the triangle strip method is in use, swap the indices of odd indexed triangles
-			if (triangleStripMethod and (triangleIndex & 1)) std::swap(indexPos1, indexPos2);
-
-			// Define triangle in NDC
-			triangleNDC[0] = currentMesh.vertices_out[indexPos0];
-			triangleNDC[1] = currentMesh.vertices_out[indexPos1];
-			triangleNDC[2] = currentMesh.vertices_out[indexPos2];
-			// Calculate the minimum depth if the current triangle, which we will use later for early-depth test
-			float minDepth = std::min(triangleNDC[0].position.z, std::min(triangleNDC[1].position.z, triangleNDC[2].position.z));
-
-			// Cull the triangle if one or more of the NDC vertices are outside the frustum
-			if (!IsNDCTriangleInFrustum(triangleNDC[0])) continue;
-			if (!IsNDCTriangleInFrustum(triangleNDC[1])) continue;
-			if (!IsNDCTriangleInFrustum(triangleNDC[2])) continue;
-
-			// Rasterize the vertices
-			RasterizeVertex(currentMesh.vertices_out[indexPos0]);
-			RasterizeVertex(currentMesh.vertices_out[indexPos1]);
-			RasterizeVertex(currentMesh.vertices_out[indexPos2]);
-
-			// Define triangle in RasterSpace
-			triangleRasterVertices[0] = currentMesh.vertices_out[indexPos0];
-			triangleRasterVertices[1] = currentMesh.vertices_out[indexPos1];
-			triangleRasterVertices[2] = currentMesh.vertices_out[indexPos2];
-			const Vector2& v0 = triangleRasterVertices[0].position.GetXY();
-			const Vector2& v1 = triangleRasterVertices[1].position.GetXY();
-			const Vector2& v2 = triangleRasterVertices[2].position.GetXY();
-
-			if (m_DrawWireFrames)
-			{
-				ColorRGB wireFrameColor = colors::White * Remap01(minDepth, 0.998f, 1.f);
+			const uint32_t instanceIndex = m_vInstanceOrder[orderIndex];
+			const Vector3 viewPosition = m_Camera.viewMatrix.TransformPoint(m_vInstances[instanceIndex].worldMatrix.GetTranslation());
+			m_vInstanceSortKeys[instanceIndex] = QuantizeViewDepth(viewPosition.z);
+		});
+	RadixSortByKey(*m_upJobSystem, RadixSortGrain, m_vInstanceSortKeys, m_vInstanceOrder, m_vInstanceSortScratch, m_vInstanceSortHistograms);
+}
+
+void dae::Renderer::SortMeshlets(MeshInstance& instance)
+{
+	if (!m_SortFrontToBack) return;
+
+	const MeshLod& lod = m_vMeshes[instance.mesh]->lods[instance.renderLod];
+
+	// The key of a meshlet is the view depth of its closest vertex, w still holds the view depth after the projection
+	m_vSortKeys.resize(lod.meshlets.size());
+	m_upJobSystem->ParallelFor(uint32_t(instance.visibleMeshlets.size()), MeshletSortGrain, [&](uint32_t visibleIndex)
+		{
+			const uint32_t meshletIndex = instance.visibleMeshlets[visibleIndex];
+			const Meshlet& meshlet = lod.meshlets[meshletIndex];
+
+			float minViewDepth{ FLT_MAX };
+			for (uint32_t vertex{ meshlet.firstVertex }; vertex < meshlet.firstVertex + meshlet.vertexCount; ++vertex)
+				minViewDepth = std::min(minViewDepth, instance.vertices_out[instance.vertexSlots[lod.meshletVertices[vertex]]].position.w);
+
+			m_vSortKeys[meshletIndex] = QuantizeViewDepth(minViewDepth);
+		});
+
+	RadixSortByKey(*m_upJobSystem, RadixSortGrain, m_vSortKeys, instance.visibleMeshlets, m_vSortScratch, m_vSortHistograms);
+}
+
+void dae::Renderer::CullMeshlets(MeshInstance& instance)
+{
+	const Mesh& mesh = *m_vMeshes[instance.mesh];
+	const MeshLod& lod = mesh.lods[instance.renderLod];
+	// AddMesh built them, the meshes are only read while drawing
+	assert(!lod.meshlets.empty() or lod.indices.empty());
 
-				DrawLine(v0.x, v0.y, v1.x, v1.y, wireFrameColor);
-				DrawLine(v1.x, v1.y, v2.x, v2.y, wireFrameColor);
-				DrawLine(v2.x, v2.y, v0.x, v0.y, wireFrameColor);
+	// The vertex stage uses it as well
+	instance.worldViewProjectionMatrix = instance.renderWorldMatrix * m_RenderViewMatrix * m_RenderProjectionMatrix;
 
-				continue;
+	instance.visibleMeshlets.clear();
+	instance.visibleVertices.clear();
+	if (!m_UseMeshletCulling)
+	{
+		instance.visibleMeshlets.resize(lod.meshlets.size());
+		std::iota(instance.visibleMeshlets.begin(), instance.visibleMeshlets.end(), 0);
+		return;
+	}
+
+	// Everything in object space, so the meshlet bounds can be tested as they are
+	const Matrix& worldViewProjectionMatrix = instance.worldViewProjectionMatrix;
+	const Frustum frustum = ExtractFrustumPlanes(worldViewProjectionMatrix);
+	const Vector3 cameraPosition = Matrix::Inverse(instance.renderWorldMatrix).TransformPoint(m_RenderCameraOrigin);
+	// Wireframes draw the back faces as well
+	const bool coneCulling = !m_DrawWireFrames and mesh.cullMode != CullMode::None;
+	// The Hi-Z holds the instances drawn before this one
+	if (m_UseHiZ) m_upHiZBuffer->Update();
+
+	for (uint32_t meshletIndex{}; meshletIndex < lod.meshlets.size(); ++meshletIndex)
+	{
+		const Meshlet& meshlet = lod.meshlets[meshletIndex];
+		if (!IsSphereInFrustum(frustum, meshlet.boundingSphere.center, meshlet.boundingSphere.radius)) continue;
+
+		// Every triangle has the culled facing when the whole sphere is on that side of the normal cone
+		if (coneCulling)
+		{
+			const Vector3 toCenter = meshlet.boundingSphere.center - cameraPosition;
+			const Vector3 culledAxis = mesh.cullMode == CullMode::Back ? meshlet.coneAxis : -meshlet.coneAxis;
+			if (Vector3::Dot(toCenter, culledAxis) >= meshlet.coneCutoff * toCenter.Magnitude() + meshlet.boundingSphere.radius) continue;
+		}
+
+		if (m_UseHiZ)
+		{
+			Vector2 ndcMin{}, ndcMax{};
+			float minDepth{};
+			if (CalculateScreenBounds(meshlet.bounds, worldViewProjectionMatrix, ndcMin, ndcMax, minDepth))
+			{
+				// NDC y points up, pixel rows go down
+				const int minX = std::clamp(int(std::floor((ndcMin.x + 1.f) * 0.5f * m_Width)), 0, m_Width - 1);
+				const int maxX = std::clamp(int(std::floor((ndcMax.x + 1.f) * 0.5f * m_Width)), 0, m_Width - 1);
+				const int minY = std::clamp(int(std::floor((1.f - ndcMax.y) * 0.5f * m_Height)), 0, m_Height - 1);
+				const int maxY = std::clamp(int(std::floor((1.f - ndcMin.y) * 0.5f * m_Height)), 0, m_Height - 1);
+				if (m_upHiZBuffer->IsOccluded(minX, minY, maxX, maxY, minDepth)) continue;
 			}
+		}
+
+		instance.visibleMeshlets.emplace_back(meshletIndex);
+	}
+
+	// Nothing culled, all vertices of the level get transformed like before
+	if (instance.visibleMeshlets.size() == lod.meshlets.size()) return;
+
+	// Vertices shared between meshlets only once, so no two threads write the same one
+	m_vVertexMarks.assign(mesh.vertices.size(), 0);
+	for (uint32_t meshletIndex : instance.visibleMeshlets)
+	{
+		const Meshlet& meshlet = lod.meshlets[meshletIndex];
+		for (uint32_t vertex{ meshlet.firstVertex }; vertex < meshlet.firstVertex + meshlet.vertexCount; ++vertex)
+		{
+			const uint32_t index = lod.meshletVertices[vertex];
+			if (m_vVertexMarks[index]) continue;
+			m_vVertexMarks[index] = 1;
+			instance.visibleVertices.emplace_back(index);
+		}
+	}
+}
+
+const std::vector<uint32_t>& dae::Renderer::GetVisibleVertices(const MeshInstance& instance) const
+{
+	const MeshLod& lod = m_vMeshes[instance.mesh]->lods[instance.renderLod];
+	return instance.visibleMeshlets.size() == lod.meshlets.size() ? lod.vertexCounter : instance.visibleVertices;
+}
+
+template<typename InstanceFunction, typename BatchFunction>
+void dae::Renderer::ForEachInstanceBatch(VertexStage stage, InstanceFunction&& renderInstance, BatchFunction&& finishBatch)
+{
+	size_t firstOrderIndex{};
+	while (firstOrderIndex < m_vRenderOrder.size())
+	{
+		// The meshlets are culled right before the batch is transformed, so the Hi-Z already holds every batch drawn before
+		size_t lastOrderIndex{ firstOrderIndex };
+		size_t vertexCount{};
+		while (lastOrderIndex < m_vRenderOrder.size() and vertexCount < VertexBatchSize)
+		{
+			MeshInstance& instance = m_vInstances[m_vRenderOrder[lastOrderIndex++]];
+			CullMeshlets(instance);
+			vertexCount += GetVisibleVertices(instance).size();
+		}
 
-			// Define the triangle's bounding box
-			Vector2 min = { FLT_MAX,  FLT_MAX };
-			Vector2 max = { -FLT_MAX, -FLT_MAX };
+		ProjectInstances(firstOrderIndex, lastOrderIndex, stage);
+
+		for (size_t orderIndex{ firstOrderIndex }; orderIndex < lastOrderIndex; ++orderIndex)
+		{
+			MeshInstance& instance = m_vInstances[m_vRenderOrder[orderIndex]];
+			SortMeshlets(instance);
+			renderInstance(instance, m_vRenderOrder[orderIndex]);
+		}
+		finishBatch();
+		firstOrderIndex = lastOrderIndex;
+	}
+}
+
+void dae::Renderer::ProjectInstances(size_t firstOrderIndex, size_t lastOrderIndex, VertexStage stage)
+{
+	// Split the visible vertices of every instance into chunks, so one parallel loop covers the whole batch
+	m_vVertexChunks.clear();
+	for (size_t orderIndex{ firstOrderIndex }; orderIndex < lastOrderIndex; ++orderIndex)
+	{
+		const uint32_t instanceIndex = m_vRenderOrder[orderIndex];
+		MeshInstance& instance = m_vInstances[instanceIndex];
+		const uint32_t visibleVertexCount = uint32_t(GetVisibleVertices(instance).size());
+		if (stage != VertexStage::Attributes)
+		{
+			instance.vertices_out.resize(visibleVertexCount);
+			instance.vertexSlots.resize(m_vMeshes[instance.mesh]->vertices.size());
+		}
+
+		for (uint32_t first{}; first < visibleVertexCount; first += VertexChunkSize)
+			m_vVertexChunks.emplace_back(VertexChunk{ instanceIndex, first, std::min(first + VertexChunkSize, visibleVertexCount) });
+	}
+
+	// The chunks are already sized for one task each
+	m_upJobSystem->ParallelFor(uint32_t(m_vVertexChunks.size()), 1, [&](uint32_t chunkIndex)
+		{
+			const VertexChunk& chunk = m_vVertexChunks[chunkIndex];
+			MeshInstance& instance = m_vInstances[chunk.instanceIndex];
+			const Mesh& mesh = *m_vMeshes[instance.mesh];
+			const std::vector<uint32_t>& visibleVertices = GetVisibleVertices(instance);
+
+			// The transformed vertices are packed, every visible vertex gets the slot of its position in the list
+			for (uint32_t slot{ chunk.first }; slot < chunk.last; ++slot)
 			{
-				// Minimums
-				min = Vector2::Min(min, v0);
-				min = Vector2::Min(min, v1);
-				min = Vector2::Min(min, v2);
-				// Clamp between screen min and max, but also make sure that, due to floating point -> int rounding happens correct
-				min.x = std::clamp(std::floor(min.x), 0.f, m_Width - 1.f);
-				min.y = std::clamp(std::floor(min.y), 0.f, m_Height - 1.f);
-
-				// Maximums
-				max = Vector2::Max(max, v0);
-				max = Vector2::Max(max, v1);
-				max = Vector2::Max(max, v2);
-				// Clamp between screen min and max, but also make sure that, due to floating point -> int rounding happens correct
-				max.x = std::clamp(std::ceil(max.x), 0.f, m_Width - 1.f);
-				max.y = std::clamp(std::ceil(max.y), 0.f, m_Height - 1.f);
+				const uint32_t index = visibleVertices[slot];
+				switch (stage)
+				{
+				case VertexStage::All:
+					instance.vertexSlots[index] = slot;
+					if (ProjectVertexPosition(mesh, instance, index, slot)) ProjectVertexAttributes(mesh, instance, index, slot);
+					break;
+				case VertexStage::Positions:
+					instance.vertexSlots[index] = slot;
+					ProjectVertexPosition(mesh, instance, index, slot);
+					break;
+				case VertexStage::Attributes:
+					// The positions must already be projected by the Positions stage
+					if (instance.vertices_out[slot].position.w > 0) ProjectVertexAttributes(mesh, instance, index, slot);
+					break;
+				}
 			}
+		});
+}
+
+bool dae::Renderer::GetTriangleIndices(const MeshLod& lod, int triangleIndex, uint32_t& indexPos0, uint32_t& indexPos1, uint32_t& indexPos2) const
+{
+	// Determine the index jump depending on the PrimitiveTopology
+	const bool triangleStripMethod = lod.primitiveTopology == PrimitiveTopology::TriangleStrip;
+	const int indexJump = triangleStripMethod ? 1 : 3;
+
+	indexPos0 = lod.indices[indexJump * triangleIndex + 0];
+	indexPos1 = lod.indices[indexJump * triangleIndex + 1];
+	indexPos2 = lod.indices[indexJump * triangleIndex + 2];
+	// Skip if duplicate indices
+	if (indexPos0 == indexPos1 or indexPos0 == indexPos2 or indexPos1 == indexPos2) return false;
+	// If the triangle strip method is in use, swap the indices of odd indexed triangles
+	if (triangleStripMethod and (triangleIndex & 1)) std::swap(indexPos1, indexPos2);
+	return true;
+}
+
+void dae::Renderer::UpdateInstanceBvh()
+{
+	// New instances change the tree itself, moved ones only the boxes above them
+	if (m_InstanceBvh.GetItemCount() != m_vInstances.size())
+	{
+		m_vInstanceBounds.resize(m_vInstances.size());
+		for (size_t instanceIndex{}; instanceIndex < m_vInstances.size(); ++instanceIndex)
+		{
+			const MeshInstance& instance = m_vInstances[instanceIndex];
+			m_vInstanceBounds[instanceIndex] = CalculateWorldBounds(m_vMeshes[instance.mesh]->bounds, instance.worldMatrix);
+		}
+		m_InstanceBvh.Build(m_vInstanceBounds);
+	}
+	else
+	{
+		for (uint32_t instanceIndex : m_vMovedInstances)
+		{
+			const MeshInstance& instance = m_vInstances[instanceIndex];
+			m_InstanceBvh.Refit(instanceIndex, CalculateWorldBounds(m_vMeshes[instance.mesh]->bounds, instance.worldMatrix));
+		}
+	}
+	m_vMovedInstances.clear();
+}
+
+void dae::Renderer::CullInstances()
+{
+	const bool useOcclusion = RasterizeOccluders();
+	m_vInstanceOrder.clear();
+	if (!m_UseFrustumCulling and !useOcclusion)
+	{
+		m_vInstanceOrder.resize(m_vInstances.size());
+		std::iota(m_vInstanceOrder.begin(), m_vInstanceOrder.end(), 0);
+		return;
+	}
+
+	const Matrix viewProjectionMatrix = m_Camera.viewMatrix * m_Camera.projectionMatrix;
+	const Frustum frustum = ExtractFrustumPlanes(viewProjectionMatrix);
+	m_InstanceBvh.Query([&](const BoundingBox& bounds)
+		{
+			if (m_UseFrustumCulling and !IsBoxInFrustum(frustum, (bounds.min + bounds.max) * 0.5f, (bounds.max - bounds.min) * 0.5f)) return false;
+			return !useOcclusion or !IsOccluded(bounds, viewProjectionMatrix);
+		},
+		[&](uint32_t instanceIndex)
+		{
+			const MeshInstance& instance = m_vInstances[instanceIndex];
+			if (m_UseFrustumCulling and !IsInstanceInFrustum(frustum, instance)) return;
+
+			// Occluders are never hidden, not even by each other
+			const Mesh& mesh = *m_vMeshes[instance.mesh];
+			if (useOcclusion and !mesh.isOccluder and IsOccluded(mesh.bounds, instance.worldMatrix * viewProjectionMatrix)) return;
+			m_vInstanceOrder.emplace_back(instanceIndex);
+		});
+
+	// Leaves come in tree order, the draw order without sorting stays the order the instances were added in
+	std::sort(m_vInstanceOrder.begin(), m_vInstanceOrder.end());
+}
+
+bool dae::Renderer::IsInstanceInFrustum(const Frustum& frustum, const MeshInstance& instance) const
+{
+	const Mesh& mesh = *m_vMeshes[instance.mesh];
+	const Matrix& worldMatrix = instance.worldMatrix;
+
+	// Sphere first, it is the cheapest and rejects most
+	const Vector3 worldCenter = worldMatrix.TransformPoint(mesh.boundingSphere.center);
+	const float maxScale = std::max({ worldMatrix.GetAxisX().Magnitude(), worldMatrix.GetAxisY().Magnitude(), worldMatrix.GetAxisZ().Magnitude() });
+	if (!IsSphereInFrustum(frustum, worldCenter, mesh.boundingSphere.radius * maxScale)) return false;
+
+	// The box is tighter for long meshes
+	const BoundingBox worldBounds = CalculateWorldBounds(mesh.bounds, worldMatrix);
+	return IsBoxInFrustum(frustum, (worldBounds.min + worldBounds.max) * 0.5f, (worldBounds.max - worldBounds.min) * 0.5f);
+}
+
+void dae::Renderer::SelectInstanceLods()
+{
+	for (uint32_t instanceIndex : m_vInstanceOrder)
+	{
+		MeshInstance& instance = m_vInstances[instanceIndex];
+		const Mesh& mesh = *m_vMeshes[instance.mesh];
+		// Occluders were already rasterized at full detail, a coarser one would no longer match what hides the rest
+		if (mesh.lods.size() == 1 or mesh.isOccluder) continue;
+
+		const Matrix& worldMatrix = instance.worldMatrix;
+		const float maxScale = std::max({ worldMatrix.GetAxisX().Magnitude(), worldMatrix.GetAxisY().Magnitude(), worldMatrix.GetAxisZ().Magnitude() });
+		const float radius = mesh.boundingSphere.radius * maxScale;
+		const float distance = (worldMatrix.TransformPoint(mesh.boundingSphere.center) - m_Camera.origin).Magnitude();
+		// Inside the sphere any part of the mesh can be right in front of the camera
+		if (!m_UseLods or distance <= radius)
+		{
+			instance.lod = 0;
+			continue;
+		}
+
+		// The errors are relative to the radius, scaled by its size on screen they are in pixels
+		const float projectedRadius = radius / (distance * m_Camera.fov) * m_Height * 0.5f;
+		uint32_t level = instance.lod;
+		while (level > 0 and mesh.lods[level].error * projectedRadius > LodPixelError * (1.f + LodHysteresis)) --level;
+		while (level + 1 < mesh.lods.size() and mesh.lods[level + 1].error * projectedRadius < LodPixelError * (1.f - LodHysteresis)) ++level;
+		instance.lod = level;
+	}
+}
 
-			// Pre-calculate the inverse area of the triangle so this doesn't need to happen for
-			// every pixels once we calculate the barycentric coordinates (as the triangle area won't change)
-			float area = Vector2::Cross(v1 - v0, v2 - v0);
-			area = abs(area);
-			float invArea = 1.f / area;
+bool dae::Renderer::RasterizeOccluders()
+{
+	if (!m_UseOcclusionCulling) return false;
+	if (std::none_of(m_vInstances.begin(), m_vInstances.end(), [&](const MeshInstance& instance) { return m_vMeshes[instance.mesh]->isOccluder; })) return false;
+
+	// Occluders go into the low resolution buffer first, positions only
+	m_upOcclusionBuffer->Clear();
+	for (const MeshInstance& instance : m_vInstances)
+	{
+		const Mesh& occluder = *m_vMeshes[instance.mesh];
+		if (!occluder.isOccluder) continue;
 
-			// For every pixel (within the bounding box)
-			for (int py{ int(min.y) }; py < int(max.y); ++py)
+		const MeshLod& lod = occluder.lods[0];
+		const Matrix worldViewProjectionMatrix = instance.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix;
+		m_vOccluderPositions.resize(occluder.vertices.size());
+		m_upJobSystem->ParallelFor(uint32_t(lod.vertexCounter.size()), OccluderVertexGrain, [&](uint32_t counterIndex)
 			{
-				for (int px{ int(min.x) }; px < int(max.x); ++px)
+				const int index = lod.vertexCounter[counterIndex];
+				Vector4 position = worldViewProjectionMatrix.TransformPoint(occluder.vertices[index].position.ToPoint4());
+				if (position.w > 0)
 				{
-					// Do an early depth test!!
-					// If the minimum depth of our triangle is already bigger than what is stored in the depth buffer (at a current pixel),
-					// there is no chance that that pixel inside the triangle will be closer, so we just skip to the next pixel
-					if (minDepth > m_pDepthBufferPixels[m_Width * py + px]) continue;
+					const float invW = 1.f / position.w;
+					position.x *= invW;
+					position.y *= invW;
+					position.z *= invW;
+				}
+				m_vOccluderPositions[index] = position;
+			});
 
+		const int triangleCount = GetTriangleCount(lod);
+		for (int triangleIndex{}; triangleIndex < triangleCount; ++triangleIndex)
+		{
+			uint32_t indexPos0{}, indexPos1{}, indexPos2{};
+			if (!GetTriangleIndices(lod, triangleIndex, indexPos0, indexPos1, indexPos2)) continue;
+			m_upOcclusionBuffer->RasterizeOccluder(m_vOccluderPositions[indexPos0], m_vOccluderPositions[indexPos1], m_vOccluderPositions[indexPos2]);
+		}
+	}
+	return true;
+}
 
-					// Declare finalColor of the pixel
-					ColorRGB finalColor{};
+bool dae::Renderer::IsOccluded(const BoundingBox& bounds, const Matrix& worldViewProjectionMatrix) const
+{
+	Vector2 ndcMin{}, ndcMax{};
+	float minDepth{};
+	if (!CalculateScreenBounds(bounds, worldViewProjectionMatrix, ndcMin, ndcMax, minDepth)) return false;
+	return m_upOcclusionBuffer->IsOccluded(ndcMin, ndcMax, minDepth);
+}
 
-					// Declare wInterpolated and zBufferValue of this pixel
-					float wInterpolated{ FLT_MAX };
-					float zBufferValue{ FLT_MAX };
+bool dae::Renderer::CalculateScreenBounds(const BoundingBox& bounds, const Matrix& worldViewProjectionMatrix, Vector2& ndcMin, Vector2& ndcMax, float& minDepth) const
+{
+	ndcMin = { FLT_MAX, FLT_MAX };
+	ndcMax = { -FLT_MAX, -FLT_MAX };
+	minDepth = FLT_MAX;
+	for (int cornerIndex{}; cornerIndex < 8; ++cornerIndex)
+	{
+		const Vector3 corner{
+			cornerIndex & 1 ? bounds.max.x : bounds.min.x,
+			cornerIndex & 2 ? bounds.max.y : bounds.min.y,
+			cornerIndex & 4 ? bounds.max.z : bounds.min.z };
+		const Vector4 position = worldViewProjectionMatrix.TransformPoint(corner.ToPoint4());
+
+		// A box that reaches behind the camera has no usable screen bounds
+		if (position.w <= m_Camera.near) return false;
+
+		const float invW = 1.f / position.w;
+		const Vector2 ndcPosition{ position.x * invW, position.y * invW };
+		ndcMin = Vector2::Min(ndcMin, ndcPosition);
+		ndcMax = Vector2::Max(ndcMax, ndcPosition);
+		minDepth = std::min(minDepth, position.z * invW);
+	}
+	return true;
+}
+
+bool dae::Renderer::SetupTriangle(const MeshInstance& instance, int triangleIndex, BinnedTriangle& triangle) const
+{
+	const Mesh& mesh = *m_vMeshes[instance.mesh];
+	uint32_t indexPos0{}, indexPos1{}, indexPos2{};
+	if (!GetTriangleIndices(mesh.lods[instance.renderLod], triangleIndex, indexPos0, indexPos1, indexPos2)) return false;
+
+	// Define triangle in NDC, the attributes stay in vertices_out until a fragment needs them
+	triangle.vertexSlots = { instance.vertexSlots[indexPos0], instance.vertexSlots[indexPos1], instance.vertexSlots[indexPos2] };
+	for (int vertex{}; vertex < 3; ++vertex)
+		triangle.positions[vertex] = instance.vertices_out[triangle.vertexSlots[vertex]].position;
+
+	// Cull the triangle if one or more of the NDC vertices are outside the frustum
+	if (!IsNDCTriangleInFrustum(triangle.positions[0])) return false;
+	if (!IsNDCTriangleInFrustum(triangle.positions[1])) return false;
+	if (!IsNDCTriangleInFrustum(triangle.positions[2])) return false;
+
+	// Rasterize the vertices, the copies that is, so vertices shared with other triangles stay in NDC
+	RasterizeVertex(triangle.positions[0]);
+	RasterizeVertex(triangle.positions[1]);
+	RasterizeVertex(triangle.positions[2]);
+
+	// The sign of the screen space area tells the facing, so culled triangles never reach the pixel loop
+	// Wireframes draw the back faces as well
+	if (m_DrawWireFrames or mesh.cullMode == CullMode::None) return true;
+	const Vector2& v0 = triangle.positions[0].GetXY();
+	const float signedArea = Vector2::Cross(triangle.positions[1].GetXY() - v0, triangle.positions[2].GetXY() - v0);
+	return mesh.cullMode == CullMode::Back ? signedArea > 0 : signedArea < 0;
+}
+
+void dae::Renderer::FetchTriangleVertices(const MeshInstance& instance, const BinnedTriangle& triangle, std::array<Vertex_Out, 3>& triangleRasterVertices) const
+{
+	// The attributes as the vertex stage left them, with the positions in raster space
+	for (int vertex{}; vertex < 3; ++vertex)
+	{
+		triangleRasterVertices[vertex] = instance.vertices_out[triangle.vertexSlots[vertex]];
+		triangleRasterVertices[vertex].position = triangle.positions[vertex];
+	}
+}
+
+template<Renderer::DepthTest Test, Renderer::ShadingMode Mode, bool UseNormalMap, bool DepthVisualization>
+void dae::Renderer::ShadeBins()
+{
+	RasterizeBins<Test>([&](const BinnedTriangle& triangle, int tileX, int tileY)
+		{
+			const MeshInstance& instance = m_vInstances[triangle.instanceIndex];
+			std::array<Vertex_Out, 3> triangleRasterVertices{};
+			FetchTriangleVertices(instance, triangle, triangleRasterVertices);
+
+			return RasterizeTriangleTile<Test>(triangle, tileX, tileY, [&](int pixelIndex, const Vector3& barycentricCoords, float zBufferValue, float wInterpolated)
+				{
+					WriteShadedPixel(pixelIndex, ShadeFragment<Mode, UseNormalMap, DepthVisualization>(triangleRasterVertices, barycentricCoords, zBufferValue, wInterpolated, instance));
+				});
+		});
+}
 
-					// Calculate the barycentric coordinates of that pixel in relationship to the triangle,
-					// these barycentric coordinates CAN be invalid (point outside triangle)
-					Vector2 pixelCoord = Vector2(px + 0.5f, py + 0.5f);
-					Vector3 barycentricCoords = CalculateBarycentricCoordinates(
-						v0, v1, v2, pixelCoord, invArea);
+void dae::Renderer::EnsureTileCleared(int tileX, int tileY)
+{
+	uint8_t& isCleared = m_vTileCleared[tileY * m_TileCountX + tileX];
+	if (isCleared) return;
+	isCleared = true;
+	ClearTile(tileX, tileY);
+}
 
-					// Check if our barycentric coordinates are valid, if not, skip to the next pixel
-					if (!AreBarycentricValid(barycentricCoords, true, false)) continue;
+void dae::Renderer::ClearTile(int tileX, int tileY)
+{
+	const int tileSize{ HiZBuffer::TileSize };
+	const int firstX{ tileX * tileSize };
+	const int endX{ std::min(firstX + tileSize, m_Width) };
+	const int endY{ std::min((tileY + 1) * tileSize, m_Height) };
+	for (int py{ tileY * tileSize }; py < endY; ++py)
+	{
+		const int firstPixel{ m_Width * py + firstX };
+		const int endPixel{ m_Width * py + endX };
+		std::fill(&m_pBackBufferPixels[firstPixel], &m_pBackBufferPixels[endPixel], ClearColor);
+		std::fill(&m_pDepthBufferPixels[firstPixel], &m_pDepthBufferPixels[endPixel], 1.f);
+		// Only the buffer of the path being drawn is read back
+		if (m_DrawRenderPath == RenderPath::Deferred) std::fill(&m_vGBuffer[firstPixel], &m_vGBuffer[endPixel], GBufferSample{});
+		else if (m_DrawRenderPath == RenderPath::VisibilityBuffer) std::fill(&m_vVisibilityBuffer[firstPixel], &m_vVisibilityBuffer[endPixel], EmptyVisibilityId);
+	}
+}
 
-					// Now we interpolated both our Z and W depths
-					InterpolateDepths(zBufferValue, wInterpolated, triangleRasterVertices, barycentricCoords);
-					if (zBufferValue < 0 or zBufferValue > 1) continue; // if z-depth is outside of frustum, skip to next pixel
-					if (wInterpolated < 0) continue; // if w-depth is negative (behind camera), skip to next pixel
+void dae::Renderer::ClearUntouchedTiles()
+{
+	// A tile nothing was drawn in only needs the clear color, and only if this back buffer showed something else there before
+	std::vector<uint8_t>& clearColorTiles = m_vClearColorTiles[m_upPresenter->GetAcquiredBufferIndex()];
+	m_upJobSystem->ParallelFor(uint32_t(m_TileCountY), 1, [&](uint32_t row)
+		{
+			const int tileY = int(row);
+			for (int tileX{}; tileX < m_TileCountX; ++tileX)
+			{
+				const int tile = tileY * m_TileCountX + tileX;
+				if (m_vTileCleared[tile])
+				{
+					clearColorTiles[tile] = false;
+					continue;
+				}
+				if (clearColorTiles[tile]) continue;
+
+				clearColorTiles[tile] = true;
+				const int tileSize{ HiZBuffer::TileSize };
+				const int firstX{ tileX * tileSize };
+				const int endX{ std::min(firstX + tileSize, m_Width) };
+				const int endY{ std::min((tileY + 1) * tileSize, m_Height) };
+				for (int py{ tileY * tileSize }; py < endY; ++py)
+					std::fill(&m_pBackBufferPixels[m_Width * py + firstX], &m_pBackBufferPixels[m_Width * py + endX], ClearColor);
+			}
+		});
+}
 
-					// If out current value in the zBuffer is smaller then our new one, skip to the next pixel
-					if (zBufferValue > m_pDepthBufferPixels[m_Width * py + px]) continue;
+bool dae::Renderer::CalculateTriangleBounds(BinnedTriangle& triangle) const
+{
+	const Vector4& position0 = triangle.positions[0];
+	const Vector4& position1 = triangle.positions[1];
+	const Vector4& position2 = triangle.positions[2];
+	const Vector2& v0 = position0.GetXY();
+	const Vector2& v1 = position1.GetXY();
+	const Vector2& v2 = position2.GetXY();
+
+	// Calculate the minimum depth if the current triangle, which we will use later for early-depth test
+	triangle.minDepth = std::min(position0.z, std::min(position1.z, position2.z));
+
+	// Pre-calculate the inverse area of the triangle so this doesn't need to happen for
+	// every pixels once we calculate the barycentric coordinates (as the triangle area won't change)
+	// Signed, so the weights inside the triangle are positive for either facing
+	const float area = Vector2::Cross(v1 - v0, v2 - v0);
+	// A degenerate triangle covers nothing
+	if (area == 0) return false;
+	triangle.invArea = 1.f / area;
+
+	// Define the triangle's bounding box
+	const Vector2 min = Vector2::Min(v0, Vector2::Min(v1, v2));
+	const Vector2 max = Vector2::Max(v0, Vector2::Max(v1, v2));
+
+	// Only the pixels whose center (px + 0.5) lies within the bounding box can be covered,
+	// clamped between screen min and max (the maximum is exclusive)
+	triangle.minX = std::max(int(std::ceil(min.x - 0.5f)), 0);
+	triangle.minY = std::max(int(std::ceil(min.y - 0.5f)), 0);
+	triangle.maxX = std::min(int(std::floor(max.x - 0.5f)) + 1, m_Width - 1);
+	triangle.maxY = std::min(int(std::floor(max.y - 0.5f)) + 1, m_Height - 1);
+	// Small triangles that fall between the pixel centers cover nothing either
+	return triangle.minX < triangle.maxX and triangle.minY < triangle.maxY;
+}
 
-					// Now that we are sure our z-depth is smaller then the one in the zBuffer, we can update the zBuffer and interpolate the attributes
-					m_pDepthBufferPixels[m_Width * py + px] = zBufferValue;
+template<Renderer::DepthTest Test>
+void dae::Renderer::BinTriangles(const MeshInstance& instance, uint32_t instanceIndex, RasterizeBinsFunction rasterizeBins)
+{
+	const int tileSize{ HiZBuffer::TileSize };
 
-					// Correctly interpolated attributes
-					Vertex_Out interpolatedAttributes{};
-					InterpolateAllAttributes(triangleRasterVertices, barycentricCoords, wInterpolated, interpolatedAttributes);
-					interpolatedAttributes.position.z = zBufferValue;
-					interpolatedAttributes.position.w = wInterpolated;
+	ForEachTriangle(instance, [&](int triangleIndex)
+		{
+			BinnedTriangle triangle{};
+			if (!SetupTriangle(instance, triangleIndex, triangle) or !CalculateTriangleBounds(triangle)) return;
+			triangle.instanceIndex = instanceIndex;
+			triangle.triangleIndex = uint32_t(triangleIndex);
 
-					finalColor = PixelShading(interpolatedAttributes, currentMesh);
+			if constexpr (Test == DepthTest::LessEqual)
+			{
+				// Hi-Z, reject the whole triangle with a few compares when it lies behind everything the batches before drew in its
+				// bounding box. A triangle that can only cover a single pixel skips it, one depth test decides it
+				const bool isSinglePixel = triangle.maxX - triangle.minX == 1 and triangle.maxY - triangle.minY == 1;
+				if (m_UseHiZ and !isSinglePixel and m_upHiZBuffer->IsOccluded(triangle.minX, triangle.minY, triangle.maxX - 1, triangle.maxY - 1, triangle.minDepth)) return;
+			}
 
-					if (m_DepthBufferVisualization)
+			const uint32_t binnedIndex = uint32_t(m_vBinnedTriangles.size());
+			bool isBinned{ false };
+			for (int tileY{ triangle.minY / tileSize }; tileY <= (triangle.maxY - 1) / tileSize; ++tileY)
+			{
+				for (int tileX{ triangle.minX / tileSize }; tileX <= (triangle.maxX - 1) / tileSize; ++tileX)
+				{
+					if constexpr (Test == DepthTest::LessEqual)
 					{
-						float remappedZ = Remap01(m_pDepthBufferPixels[m_Width * py + px], 0.998f, 1);
-						finalColor = { remappedZ , remappedZ , remappedZ };
+						// Leave the tile out if the triangle is behind the farthest depth in it
+						if (m_UseHiZ and triangle.minDepth > m_upHiZBuffer->GetTileMaxDepth(tileX, tileY)) continue;
 					}
 
-					// Make sure our colors are within the correct 0-1 range (while keeping relative differences)
-					finalColor.MaxToOne();
+					const uint32_t tile = uint32_t(tileY * m_TileCountX + tileX);
+					std::vector<uint32_t>& bin = m_vTileBins[tile];
+					if (bin.empty()) m_vBinnedTiles.emplace_back(tile);
+					bin.emplace_back(binnedIndex);
+					isBinned = true;
+				}
+			}
+			if (!isBinned) return;
+			m_vBinnedTriangles.emplace_back(triangle);
+			if (m_vBinnedTriangles.size() == BinnedTriangleBudget) (this->*rasterizeBins)();
+		});
+}
 
+template<Renderer::DepthTest Test, typename TriangleFunction>
+void dae::Renderer::RasterizeBins(TriangleFunction&& rasterizeTriangle)
+{
+	m_vBinnedTileDepthWritten.assign(m_vBinnedTiles.size(), uint8_t(false));
+	m_upJobSystem->ParallelFor(uint32_t(m_vBinnedTiles.size()), TileBinGrain, [&](uint32_t binnedTileIndex)
+		{
+			const uint32_t tile = m_vBinnedTiles[binnedTileIndex];
+			const int tileX = int(tile) % m_TileCountX;
+			const int tileY = int(tile) / m_TileCountX;
+			EnsureTileCleared(tileX, tileY);
+
+			bool depthWritten{ false };
+			int trianglesSinceHiZUpdate{};
+			std::vector<uint32_t>& bin = m_vTileBins[tile];
+			for (uint32_t binnedIndex : bin)
+			{
+				const BinnedTriangle& triangle = m_vBinnedTriangles[binnedIndex];
+				if constexpr (Test == DepthTest::LessEqual)
+				{
+					// Skip the triangle if it is behind the farthest depth in the tile
+					if (m_UseHiZ and triangle.minDepth > m_upHiZBuffer->GetTileMaxDepth(tileX, tileY)) continue;
+				}
 
-					//Update Color in Buffer
-					m_pBackBufferPixels[m_Width * py + px] = SDL_MapRGB(m_pBackBuffer->format,
-						static_cast<uint8_t>(finalColor.r * 255),
-						static_cast<uint8_t>(finalColor.g * 255),
-						static_cast<uint8_t>(finalColor.b * 255));
+				if (!rasterizeTriangle(triangle, tileX, tileY)) continue;
+				depthWritten = true;
+				if (m_UseHiZ and ++trianglesSinceHiZUpdate == HiZUpdateInterval)
+				{
+					m_upHiZBuffer->UpdateTile(tileX, tileY);
+					trianglesSinceHiZUpdate = 0;
 				}
 			}
+			bin.clear();
+			m_vBinnedTileDepthWritten[binnedTileIndex] = depthWritten;
+		});
+
+	// The Hi-Z levels above the tiles are shared, they are only refreshed once every tile is done
+	if (m_UseHiZ)
+	{
+		for (size_t binnedTileIndex{}; binnedTileIndex < m_vBinnedTiles.size(); ++binnedTileIndex)
+		{
+			if (!m_vBinnedTileDepthWritten[binnedTileIndex]) continue;
+			const int tile = int(m_vBinnedTiles[binnedTileIndex]);
+			m_upHiZBuffer->MarkTileDirty(tile % m_TileCountX, tile / m_TileCountX);
 		}
+		m_upHiZBuffer->Update();
 	}
+	m_vBinnedTiles.clear();
+	m_vBinnedTriangles.clear();
+}
 
+template<Renderer::DepthTest Test, typename FragmentFunction>
+bool dae::Renderer::RasterizeTriangleTile(const BinnedTriangle& triangle, int tileX, int tileY, FragmentFunction&& onFragment)
+{
+	const Vector4& position0 = triangle.positions[0];
+	const Vector4& position1 = triangle.positions[1];
+	const Vector4& position2 = triangle.positions[2];
+	const int tileSize{ HiZBuffer::TileSize };
+
+	// For every pixel of the bounding box within the tile
+	bool depthWritten{ false };
+	const int endY{ std::min(triangle.maxY, (tileY + 1) * tileSize) };
+	const int endX{ std::min(triangle.maxX, (tileX + 1) * tileSize) };
+	for (int py{ std::max(triangle.minY, tileY * tileSize) }; py < endY; ++py)
+	{
+		for (int px{ std::max(triangle.minX, tileX * tileSize) }; px < endX; ++px)
+		{
+			const int pixelIndex{ m_Width * py + px };
 
-	// @END
-	SDL_UnlockSurface(m_pBackBuffer);
-	SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
-	SDL_UpdateWindowSurface(m_pWindow);
+			// Do an early depth test!!
+			// If the minimum depth of our triangle is already bigger than what is stored in the depth buffer (at a current pixel),
+			// there is no chance that that pixel inside the triangle will be closer, so we just skip to the next pixel
+			// The interpolated depth can end up slightly below minDepth though, so the equal test can't take this shortcut
+			if constexpr (Test == DepthTest::LessEqual)
+			{
+				if (triangle.minDepth > m_pDepthBufferPixels[pixelIndex]) continue;
+			}
+
+			Vector3 barycentricCoords{};
+			float zBufferValue{}, wInterpolated{};
+			if (!CalculatePixelDepth(position0, position1, position2, px, py, triangle.invArea, barycentricCoords, zBufferValue, wInterpolated)) continue;
+
+			if constexpr (Test == DepthTest::Equal)
+			{
+				// The depth pre-pass already settled the depth buffer, only the closest fragment gets through
+				if (zBufferValue != m_pDepthBufferPixels[pixelIndex]) continue;
+			}
+			else
+			{
+				// If out current value in the zBuffer is smaller then our new one, skip to the next pixel
+				if (zBufferValue > m_pDepthBufferPixels[pixelIndex]) continue;
+
+				// Now that we are sure our z-depth is smaller then the one in the zBuffer, we can update the zBuffer and hand the fragment over
+				m_pDepthBufferPixels[pixelIndex] = zBufferValue;
+				depthWritten = true;
+			}
+
+			onFragment(pixelIndex, barycentricCoords, zBufferValue, wInterpolated);
+		}
+	}
+	return depthWritten;
+}
+
+template<Renderer::ShadingMode Mode, bool UseNormalMap, bool DepthVisualization>
+ColorRGB dae::Renderer::ShadeFragment(const std::array<Vertex_Out, 3>& triangleRasterVertices, const Vector3& barycentricCoords, float zBufferValue, float wInterpolated, const MeshInstance& instance) const
+{
+	if constexpr (DepthVisualization)
+	{
+		float remappedZ = Remap01(zBufferValue, 0.998f, 1);
+		return { remappedZ , remappedZ , remappedZ };
+	}
+	else
+	{
+		// Correctly interpolated attributes, only the ones this shading mode reads
+		Vertex_Out interpolatedAttributes{};
+		InterpolateAttributes<Mode, UseNormalMap>(triangleRasterVertices, barycentricCoords, wInterpolated, interpolatedAttributes);
+		interpolatedAttributes.position.z = zBufferValue;
+		interpolatedAttributes.position.w = wInterpolated;
+
+		return PixelShading<Mode, UseNormalMap>(interpolatedAttributes, *m_vMeshes[instance.mesh]) * instance.tint;
+	}
+}
+
+void dae::Renderer::WriteShadedPixel(int pixelIndex, const ColorRGB& finalColor)
+{
+	// The linear color is kept for the resolve pass, otherwise it is clamped and packed right away
+	if (m_ResolveHdr) m_vHdrBuffer[pixelIndex] = finalColor;
+	else m_pBackBufferPixels[pixelIndex] = PackColor(finalColor);
+}
+
+uint32_t dae::Renderer::PackColor(const ColorRGB& color) const
+{
+	// Same steps as ColorRGB::MaxToOne and the truncating casts to 8 bits, on all three channels at once
+#if defined(__SSE2__) || defined(_M_X64)
+	const __m128 channels = _mm_setr_ps(color.r, color.g, color.b, 0.f);
+	__m128 maxValue = _mm_max_ps(channels, _mm_shuffle_ps(channels, channels, _MM_SHUFFLE(3, 0, 2, 1)));
+	maxValue = _mm_max_ps(maxValue, _mm_shuffle_ps(channels, channels, _MM_SHUFFLE(3, 1, 0, 2)));
+	// Colors within range are scaled by exactly one, so no branch is needed
+	const __m128 invScale = _mm_div_ps(_mm_set1_ps(1.f), _mm_max_ps(maxValue, _mm_set1_ps(1.f)));
+	__m128 scaled = _mm_mul_ps(_mm_mul_ps(channels, invScale), _mm_set1_ps(255.f));
+	scaled = _mm_max_ps(scaled, _mm_setzero_ps());
+	return LayoutPixel(PackChannelBytes(scaled));
+#else
+	ColorRGB finalColor = color;
+	finalColor.MaxToOne();
+	const uint32_t red = static_cast<uint8_t>(std::max(finalColor.r, 0.f) * 255);
+	const uint32_t green = static_cast<uint8_t>(std::max(finalColor.g, 0.f) * 255);
+	const uint32_t blue = static_cast<uint8_t>(std::max(finalColor.b, 0.f) * 255);
+	return LayoutPixel(red | (green << 8) | (blue << 16));
+#endif
+}
+
+uint32_t dae::Renderer::TonemapColor(const ColorRGB& color) const
+{
+	// Narkowicz's fit of the ACES filmic curve, x(2.51x + 0.03) / (x(2.43x + 0.59) + 0.14), then gamma 2 and rounded to 8 bits
+#if defined(__SSE2__) || defined(_M_X64)
+	const __m128 x = _mm_max_ps(_mm_setr_ps(color.r, color.g, color.b, 0.f), _mm_setzero_ps());
+	const __m128 numerator = _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(2.51f)), _mm_set1_ps(0.03f)));
+	const __m128 denominator = _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(2.43f)), _mm_set1_ps(0.59f))), _mm_set1_ps(0.14f));
+	const __m128 mapped = _mm_min_ps(_mm_div_ps(numerator, denominator), _mm_set1_ps(1.f));
+	const __m128 scaled = _mm_add_ps(_mm_mul_ps(_mm_sqrt_ps(mapped), _mm_set1_ps(255.f)), _mm_set1_ps(0.5f));
+	return LayoutPixel(PackChannelBytes(scaled));
+#else
+	const auto tonemap = [](float x)
+		{
+			x = std::max(x, 0.f);
+			const float mapped = std::min(x * (2.51f * x + 0.03f) / (x * (2.43f * x + 0.59f) + 0.14f), 1.f);
+			return uint32_t(static_cast<uint8_t>(std::sqrt(mapped) * 255.f + 0.5f));
+		};
+	return LayoutPixel(tonemap(color.r) | (tonemap(color.g) << 8) | (tonemap(color.b) << 16));
+#endif
+}
+
+uint32_t dae::Renderer::LayoutPixel(uint32_t bytes) const
+{
+	const uint32_t red = bytes & 0xFF;
+	const uint32_t green = (bytes >> 8) & 0xFF;
+	const uint32_t blue = (bytes >> 16) & 0xFF;
+	return (red << m_PixelLayout.redShift) | (green << m_PixelLayout.greenShift) | (blue << m_PixelLayout.blueShift) | m_PixelLayout.alphaMask;
+}
+
+void dae::Renderer::ResolveHdrRows(int firstRow, int lastRow)
+{
+	const int tileSize{ HiZBuffer::TileSize };
+	for (int py{ firstRow }; py < lastRow; ++py)
+	{
+		for (int tileX{}; tileX < m_TileCountX; ++tileX)
+		{
+			// Tiles nothing was drawn in get the clear color at the end of the frame
+			if (!m_vTileCleared[(py / tileSize) * m_TileCountX + tileX]) continue;
+
+			// Uncovered pixels keep the clear color and the wireframes, neither of them writes depth
+			const int endX{ std::min((tileX + 1) * tileSize, m_Width) };
+			for (int px{ tileX * tileSize }; px < endX; ++px)
+			{
+				const int pixelIndex = m_Width * py + px;
+				if (m_pDepthBufferPixels[pixelIndex] >= 1.f) continue;
+				m_pBackBufferPixels[pixelIndex] = TonemapColor(m_vHdrBuffer[pixelIndex]);
+			}
+		}
+	}
 }
 
-void dae::Renderer::ProjectMeshToNDC(Mesh& mesh) const
+void dae::Renderer::ResolveHdrBuffer()
 {
-	mesh.vertices_out.resize(mesh.vertices.size());
+	m_upJobSystem->ParallelFor(uint32_t((m_Height + HdrResolveRows - 1) / HdrResolveRows), 1, [&](uint32_t tile)
+		{
+			const int firstRow = int(tile) * HdrResolveRows;
+			const int lastRow = std::min(firstRow + HdrResolveRows, m_Height);
+			ResolveHdrRows(firstRow, lastRow);
+		});
+}
 
-	// Calculate the transformation matrix
-	Matrix worldViewProjectionMatrix = mesh.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix;
-	
-	std::for_each(std::execution::par, mesh.vertexCounter.begin(), mesh.vertexCounter.end(), [&](int index)
+template<Renderer::RenderPath Path>
+void dae::Renderer::RasterizeBinsVisibility()
+{
+	RasterizeBins<DepthTest::LessEqual>([&](const BinnedTriangle& triangle, int tileX, int tileY)
 		{
-			// Transform every vertex
-			Vector4 transformedPosition = worldViewProjectionMatrix.TransformPoint(mesh.vertices[index].position.ToPoint4());
-			mesh.vertices_out[index].position = transformedPosition;
+			const uint32_t visibilityId = PackVisibilityId(triangle.instanceIndex, triangle.triangleIndex);
+			return RasterizeTriangleTile<DepthTest::LessEqual>(triangle, tileX, tileY, [&](int pixelIndex, const Vector3& barycentricCoords, float, float)
+				{
+					if constexpr (Path == RenderPath::Deferred)
+					{
+						// The third weight follows from the other two, they always add up to one
+						m_vGBuffer[pixelIndex] = { visibilityId, barycentricCoords.x, barycentricCoords.y };
+					}
+					else
+					{
+						m_vVisibilityBuffer[pixelIndex] = visibilityId;
+					}
+				});
+		});
+}
+
+template<Renderer::RenderPath Path>
+Renderer::ShadePassFunction dae::Renderer::SelectShadePassFunction() const
+{
+	if (m_DepthBufferVisualization) return &Renderer::ShadeVisiblePixels<Path, ShadingMode::Combined, false, true>;
+
+	switch (m_CurrentShadingMode)
+	{
+	case dae::Renderer::ShadingMode::ObservedArea:
+		return m_UseNormalMap	? &Renderer::ShadeVisiblePixels<Path, ShadingMode::ObservedArea, true, false>
+								: &Renderer::ShadeVisiblePixels<Path, ShadingMode::ObservedArea, false, false>;
+	case dae::Renderer::ShadingMode::Diffuse:
+		return &Renderer::ShadeVisiblePixels<Path, ShadingMode::Diffuse, false, false>;
+	case dae::Renderer::ShadingMode::Specular:
+		return m_UseNormalMap	? &Renderer::ShadeVisiblePixels<Path, ShadingMode::Specular, true, false>
+								: &Renderer::ShadeVisiblePixels<Path, ShadingMode::Specular, false, false>;
+	case dae::Renderer::ShadingMode::Combined:
+	default:
+		return m_UseNormalMap	? &Renderer::ShadeVisiblePixels<Path, ShadingMode::Combined, true, false>
+								: &Renderer::ShadeVisiblePixels<Path, ShadingMode::Combined, false, false>;
+	}
+}
+
+template<Renderer::RenderPath Path, Renderer::ShadingMode Mode, bool UseNormalMap, bool DepthVisualization>
+void dae::Renderer::ShadeVisiblePixels()
+{
+	// Every row is shaded independently
+	m_upJobSystem->ParallelFor(uint32_t(m_Height), ShadeRowGrain, [&](uint32_t row)
+		{
+			const int py = int(row);
+			// Neighbouring pixels mostly belong to the same triangle, so only fetch it again when it changes
+			BinnedTriangle triangle{};
+			std::array<Vertex_Out, 3> triangleRasterVertices{};
+			uint32_t fetchedVisibilityId{ EmptyVisibilityId };
+			float invArea{};
+
+			const uint8_t* pTileCleared = &m_vTileCleared[(py / HiZBuffer::TileSize) * m_TileCountX];
+			for (int px{}; px < m_Width; ++px)
+			{
+				// Nothing was drawn in tiles that were never cleared, their buffers still hold an older frame
+				if (px % HiZBuffer::TileSize == 0 and !pTileCleared[px / HiZBuffer::TileSize])
+				{
+					px += HiZBuffer::TileSize - 1;
+					continue;
+				}
 
-			if (mesh.vertices_out[index].position.w <= 0) return;
+				const int pixelIndex = m_Width * py + px;
+				uint32_t visibilityId{};
+				if constexpr (Path == RenderPath::Deferred) visibilityId = m_vGBuffer[pixelIndex].visibilityId;
+				else visibilityId = m_vVisibilityBuffer[pixelIndex];
+				if (visibilityId == EmptyVisibilityId) continue;
 
-			// Perform the perspective divide
-			float invW = 1.f / transformedPosition.w;
-			mesh.vertices_out[index].position.x *= invW;
-			mesh.vertices_out[index].position.y *= invW;
-			mesh.vertices_out[index].position.z *= invW;
+				const float zBufferValue = m_pDepthBufferPixels[pixelIndex];
+				if constexpr (DepthVisualization)
+				{
+					float remappedZ = Remap01(zBufferValue, 0.998f, 1);
+					WriteShadedPixel(pixelIndex, { remappedZ , remappedZ , remappedZ });
+					continue;
+				}
 
+				const MeshInstance& currentInstance = m_vInstances[visibilityId >> VisibilityTriangleBits];
+				if (visibilityId != fetchedVisibilityId)
+				{
+					SetupTriangle(currentInstance, int(visibilityId & VisibilityTriangleMask), triangle);
+					FetchTriangleVertices(currentInstance, triangle, triangleRasterVertices);
+					fetchedVisibilityId = visibilityId;
+					if constexpr (Path == RenderPath::VisibilityBuffer)
+					{
+						// Signed like in the raster pass
+						const Vector2& v0 = triangleRasterVertices[0].position.GetXY();
+						invArea = 1.f / Vector2::Cross(triangleRasterVertices[1].position.GetXY() - v0, triangleRasterVertices[2].position.GetXY() - v0);
+					}
+				}
 
-			// Update the other attributes
-			mesh.vertices_out[index].color = mesh.vertices[index].color;
-			mesh.vertices_out[index].uv = mesh.vertices[index].uv;
+				Vector3 barycentricCoords{};
+				if constexpr (Path == RenderPath::Deferred)
+				{
+					const GBufferSample& sample = m_vGBuffer[pixelIndex];
+					barycentricCoords = { sample.weight0, sample.weight1, 1.f - sample.weight0 - sample.weight1 };
+				}
+				else
+				{
+					// Only the triangle was stored, the weights are recomputed for the pixel center like the raster pass did
+					barycentricCoords = CalculateBarycentricCoordinates(triangleRasterVertices[0].position.GetXY(),
+						triangleRasterVertices[1].position.GetXY(), triangleRasterVertices[2].position.GetXY(),
+						Vector2(px + 0.5f, py + 0.5f), invArea);
+				}
 
-			mesh.vertices_out[index].normal			= mesh.worldMatrix.TransformVector(mesh.vertices[index].normal).Normalized();
-			mesh.vertices_out[index].tangent		= mesh.worldMatrix.TransformVector(mesh.vertices[index].tangent).Normalized();
-			mesh.vertices_out[index].viewDirection  = (mesh.worldMatrix.TransformPoint(mesh.vertices_out[index].position)
-													- m_Camera.origin.ToPoint4()).Normalized();
+				float zInterpolated{}, wInterpolated{};
+				InterpolateDepths(zInterpolated, wInterpolated, triangleRasterVertices, barycentricCoords);
 
+				WriteShadedPixel(pixelIndex, ShadeFragment<Mode, UseNormalMap, false>(triangleRasterVertices, barycentricCoords, zBufferValue, wInterpolated, currentInstance));
+			}
 
+			// The row is final, so it is resolved while the other rows are still being shaded
+			if (m_ResolveHdr) ResolveHdrRows(py, py + 1);
 		});
 }
+
+void dae::Renderer::RenderMeshWireFrames(MeshInstance& currentInstance)
+{
+	BinnedTriangle triangle{};
+
+	// Only the visible meshlets have their vertices transformed
+	ForEachTriangle(currentInstance, [&](int triangleIndex)
+		{
+			if (!SetupTriangle(currentInstance, triangleIndex, triangle)) return;
+			const Vector2& v0 = triangle.positions[0].GetXY();
+			const Vector2& v1 = triangle.positions[1].GetXY();
+			const Vector2& v2 = triangle.positions[2].GetXY();
+
+			float minDepth = std::min(triangle.positions[0].z, std::min(triangle.positions[1].z, triangle.positions[2].z));
+			ColorRGB wireFrameColor = colors::White * Remap01(minDepth, 0.998f, 1.f);
+
+			DrawLine(v0.x, v0.y, v1.x, v1.y, wireFrameColor);
+			DrawLine(v1.x, v1.y, v2.x, v2.y, wireFrameColor);
+			DrawLine(v2.x, v2.y, v0.x, v0.y, wireFrameColor);
+		});
+}
+
+bool dae::Renderer::ProjectVertexPosition(const Mesh& mesh, MeshInstance& instance, uint32_t index, uint32_t slot) const
+{
+	// Transform every vertex
+	Vector4 transformedPosition = instance.worldViewProjectionMatrix.TransformPoint(mesh.vertices[index].position.ToPoint4());
+	Vertex_Out& vertexOut = instance.vertices_out[slot];
+	vertexOut.position = transformedPosition;
+
+	if (vertexOut.position.w <= 0) return false;
+
+	// Perform the perspective divide
+	float invW = 1.f / transformedPosition.w;
+	vertexOut.position.x *= invW;
+	vertexOut.position.y *= invW;
+	vertexOut.position.z *= invW;
+	return true;
+}
+
+void dae::Renderer::ProjectVertexAttributes(const Mesh& mesh, MeshInstance& instance, uint32_t index, uint32_t slot) const
+{
+	const Vertex& vertex = mesh.vertices[index];
+	Vertex_Out& vertexOut = instance.vertices_out[slot];
+
+	// Update the other attributes
+	vertexOut.color = vertex.color;
+	vertexOut.uv = vertex.uv;
+
+	vertexOut.normal		= instance.renderWorldMatrix.TransformVector(vertex.normal).Normalized();
+	vertexOut.tangent		= instance.renderWorldMatrix.TransformVector(vertex.tangent).Normalized();
+	vertexOut.viewDirection	= (instance.renderWorldMatrix.TransformPoint(vertexOut.position)
+							- m_RenderCameraOrigin.ToPoint4()).Normalized();
+}
+
 void dae::Renderer::RasterizeVertex(Vertex_Out& vertex) const
 {
-	vertex.position.x = (1.f + vertex.position.x) * 0.5f * m_Width;
-	vertex.position.y = (1.f - vertex.position.y) * 0.5f * m_Height;
+	RasterizeVertex(vertex.position);
+}
+void dae::Renderer::RasterizeVertex(Vector4& position) const
+{
+	position.x = (1.f + position.x) * 0.5f * m_Width;
+	position.y = (1.f - position.y) * 0.5f * m_Height;
 }
 
-void dae::Renderer::InterpolateDepths(float& zDepth, float& wDepth, const std::array<Vertex_Out, 3>& triangle, const Vector3& weights)
+void dae::Renderer::InterpolateDepths(float& zDepth, float& wDepth, const std::array<Vertex_Out, 3>& triangle, const Vector3& weights) const
 {
 	// Now we interpolated both our Z and W depths
 	const float& Z0 = triangle[0].position.z;
@@ -295,100 +1440,107 @@ void dae::Renderer::InterpolateDepths(float& zDepth, float& wDepth, const std::a
 	const float& W2 = triangle[2].position.w;
 	wDepth = InterpolateDepth(W0, W1, W2, weights);
 }
-void dae::Renderer::InterpolateAllAttributes(const std::array<Vertex_Out, 3>& triangle, const Vector3& weights, const float wInterpolated, Vertex_Out& output)
+template<Renderer::ShadingMode Mode, bool UseNormalMap>
+void dae::Renderer::InterpolateAttributes(const std::array<Vertex_Out, 3>& triangle, const Vector3& weights, const float wInterpolated, Vertex_Out& output) const
 {
+	// Which attributes the shading mode reads
+	constexpr bool needsNormal			= Mode != ShadingMode::Diffuse;
+	constexpr bool needsTangent			= needsNormal and UseNormalMap;
+	constexpr bool needsUV				= Mode != ShadingMode::ObservedArea or UseNormalMap;
+	constexpr bool needsViewDirection	= Mode == ShadingMode::Specular or Mode == ShadingMode::Combined;
+
 	// Get W components
 	const float& W0 = triangle[0].position.w;
 	const float& W1 = triangle[1].position.w;
 	const float& W2 = triangle[2].position.w;
 
-	// Correctly interpolated position
-	const Vector4& P0 = triangle[0].position;
-	const Vector4& P1 = triangle[1].position;
-	const Vector4& P2 = triangle[2].position;
-	output.position = InterpolateAttribute(P0, P1, P2, W0, W1, W2, wInterpolated, weights);
-
-	// Correctly interpolated color
-	const ColorRGB& C0 = triangle[0].color;
-	const ColorRGB& C1 = triangle[1].color;
-	const ColorRGB& C2 = triangle[2].color;
-	output.color = InterpolateAttribute(C0, C1, C2, W0, W1, W2, wInterpolated, weights);
-
 	// Correctly interpolated uv
-	const Vector2& UV0 = triangle[0].uv;
-	const Vector2& UV1 = triangle[1].uv;
-	const Vector2& UV2 = triangle[2].uv;
-	output.uv = InterpolateAttribute(UV0, UV1, UV2, W0, W1, W2, wInterpolated, weights);
+	if constexpr (needsUV)
+	{
+		const Vector2& UV0 = triangle[0].uv;
+		const Vector2& UV1 = triangle[1].uv;
+		const Vector2& UV2 = triangle[2].uv;
+		output.uv = InterpolateAttribute(UV0, UV1, UV2, W0, W1, W2, wInterpolated, weights);
+	}
 
 	// Correctly interpolated normal
-	const Vector3& N0 = triangle[0].normal;
-	const Vector3& N1 = triangle[1].normal;
-	const Vector3& N2 = triangle[2].normal;
-	output.normal = InterpolateAttribute(N0, N1, N2, W0, W1, W2, wInterpolated, weights);
-	output.normal.Normalize();
+	if constexpr (needsNormal)
+	{
+		const Vector3& N0 = triangle[0].normal;
+		const Vector3& N1 = triangle[1].normal;
+		const Vector3& N2 = triangle[2].normal;
+		output.normal = InterpolateAttribute(N0, N1, N2, W0, W1, W2, wInterpolated, weights);
+		output.normal.Normalize();
+	}
 
 	// Correctly interpolated tangent
-	const Vector3& T0 = triangle[0].tangent;
-	const Vector3& T1 = triangle[1].tangent;
-	const Vector3& T2 = triangle[2].tangent;
-	output.tangent = InterpolateAttribute(T0, T1, T2, W0, W1, W2, wInterpolated, weights);
-	output.tangent.Normalize();
+	if constexpr (needsTangent)
+	{
+		const Vector3& T0 = triangle[0].tangent;
+		const Vector3& T1 = triangle[1].tangent;
+		const Vector3& T2 = triangle[2].tangent;
+		output.tangent = InterpolateAttribute(T0, T1, T2, W0, W1, W2, wInterpolated, weights);
+		output.tangent.Normalize();
+	}
 
 	// Correctly interpolated viewDirection
-	const Vector3& VD0 = triangle[0].viewDirection;
-	const Vector3& VD1 = triangle[1].viewDirection;
-	const Vector3& VD2 = triangle[2].viewDirection;
-	output.viewDirection = InterpolateAttribute(VD0, VD1, VD2, W0, W1, W2, wInterpolated, weights);
-	output.viewDirection.Normalize();
+	if constexpr (needsViewDirection)
+	{
+		const Vector3& VD0 = triangle[0].viewDirection;
+		const Vector3& VD1 = triangle[1].viewDirection;
+		const Vector3& VD2 = triangle[2].viewDirection;
+		output.viewDirection = InterpolateAttribute(VD0, VD1, VD2, W0, W1, W2, wInterpolated, weights);
+		output.viewDirection.Normalize();
+	}
 }
 
-ColorRGB dae::Renderer::PixelShading(const Vertex_Out& v, Mesh& m)
+template<Renderer::ShadingMode Mode, bool UseNormalMap>
+ColorRGB dae::Renderer::PixelShading(const Vertex_Out& v, const Mesh& m) const
 {
-	// Ambient Color
-	const ColorRGB ambient = { 0.03f, 0.03f, 0.03f };
+	// Ambient color and light from the scene
+	const ColorRGB& ambient = m_Ambient;
+	const Vector3& directionToLight = m_DirectionToLight;
 
-	// Set up the light
-	Vector3 lightDirection = { 0.577f , -0.577f , 0.577f };
-	Vector3 directionToLight = -lightDirection.Normalized();
+	// Lambert diffuse and phong settings
+	const float kd = 7.f;
+	const float shininess = 25.f;
+
+	// The diffuse color is the only mode that doesn't need the normal
+	if constexpr (Mode == ShadingMode::Diffuse)
+	{
+		const ColorRGB cd = m.SampleDiffuse(v.uv);
+		return (cd * kd) * ONE_DIV_PI;
+	}
 
 	// Sample the normal
 	Vector3 sampledNormal{};
-	if (m_UseNormalMap)		sampledNormal = m.SampleNormalMap(v.normal, v.tangent, v.uv);
-	else					sampledNormal = v.normal;
-
-	// Calculate the observed area
-	const float observedArea = Vector3::Dot(sampledNormal, directionToLight);
-	// Skipping if observedArea < 0 happens when we check for the Current Shading Mode, as we really only want to skip (return black) if
-	// We are actualy in a mode that uses observedArea (ObservedArea and Combined)
+	if constexpr (UseNormalMap)	sampledNormal = m.SampleNormalMap(v.normal, v.tangent, v.uv);
+	else						sampledNormal = v.normal;
 
-	// Calculate the lambert diffuse color
-	const ColorRGB cd = m.SampleDiffuse(v.uv);
-	const float kd = 7.f;
-	const ColorRGB lambertDiffuse = (cd * kd) * ONE_DIV_PI;
+	if constexpr (Mode == ShadingMode::Specular)
+	{
+		return m.SamplePhong(directionToLight, v.viewDirection, sampledNormal, v.uv, shininess);
+	}
 
-	// Calculate the specularity
-	const float shininess = 25.f;
-	const ColorRGB specular = m.SamplePhong(directionToLight, v.viewDirection, sampledNormal, v.uv, shininess);
+	// Calculate the observed area, the modes that use it return black when the surface faces away from the light
+	// before sampling any other texture
+	const float observedArea = Vector3::Dot(sampledNormal, directionToLight);
+	if (observedArea <= 0.f) return {};
 
-	switch (m_CurrentShadingMode)
+	if constexpr (Mode == ShadingMode::ObservedArea)
 	{
-	case dae::Renderer::ShadingMode::ObservedArea:
-		if (observedArea <= 0.f) return{};
 		return ColorRGB{ observedArea, observedArea, observedArea };
-		break;
-	case dae::Renderer::ShadingMode::Diffuse:
-		return lambertDiffuse;
-		break;
-	case dae::Renderer::ShadingMode::Specular:
-		return specular;
-		break;
-	case dae::Renderer::ShadingMode::Combined:
-		if (observedArea <= 0.f) return{};
-		return (lambertDiffuse + specular + ambient) * observedArea;
-		break;
-	default:
+	}
+	else
+	{
+		// Calculate the lambert diffuse color
+		const ColorRGB cd = m.SampleDiffuse(v.uv);
+		const ColorRGB lambertDiffuse = (cd * kd) * ONE_DIV_PI;
+
+		// Calculate the specularity
+		const ColorRGB specular = m.SamplePhong(directionToLight, v.viewDirection, sampledNormal, v.uv, shininess);
+
 		return (lambertDiffuse + specular + ambient) * observedArea;
-		break;
 	}
 }
 
@@ -409,10 +1561,8 @@ void dae::Renderer::DrawLine(int x0, int y0, int x1, int y1, const ColorRGB& col
 		if (y0 < m_Height and y0 >= 0
 			and x0 < m_Width and x0 >= 0)
 		{
-			m_pBackBufferPixels[m_Width * y0 + x0] = SDL_MapRGB(m_pBackBuffer->format,
-				static_cast<uint8_t>(color.r * 255),
-				static_cast<uint8_t>(color.g * 255),
-				static_cast<uint8_t>(color.b * 255));
+			EnsureTileCleared(x0 / HiZBuffer::TileSize, y0 / HiZBuffer::TileSize);
+			m_pBackBufferPixels[m_Width * y0 + x0] = PackColor(color);
 		}
 
 		if (x0 == x1 && y0 == y1) break;
@@ -422,8 +1572,20 @@ void dae::Renderer::DrawLine(int x0, int y0, int x1, int y1, const ColorRGB& col
 	}
 }
 
+FramePacingStats dae::Renderer::GetFramePacingStats() const
+{
+	return m_upPresenter->GetPacingStats();
+}
+
+void dae::Renderer::ResetFramePacingStats()
+{
+	m_upPresenter->ResetPacingStats();
+}
+
 bool Renderer::SaveBufferToImage() const
 {
+	// The last frame may still be on its way to the window
+	m_upPresenter->WaitUntilPresented();
 	return SDL_SaveBMP(m_pBackBuffer, "Rasterizer_ColorBuffer.bmp");
 }
 
@@ -447,3 +1609,24 @@ void dae::Renderer::CycleShadingMode()
 		break;
 	}
 }
+
+void dae::Renderer::CycleRenderPath()
+{
+	switch (m_CurrentRenderPath)
+	{
+	case dae::Renderer::RenderPath::Forward:
+		m_CurrentRenderPath = RenderPath::Deferred;
+		break;
+	case dae::Renderer::RenderPath::Deferred:
+		m_CurrentRenderPath = RenderPath::VisibilityBuffer;
+		break;
+	case dae::Renderer::RenderPath::VisibilityBuffer:
+		m_CurrentRenderPath = RenderPath::DepthPrePass;
+		break;
+	case dae::Renderer::RenderPath::DepthPrePass:
+		m_CurrentRenderPath = RenderPath::Forward;
+		break;
+	default:
+		break;
+	}
+}
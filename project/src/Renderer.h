@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cassert>
 #include <memory>
 #include <cstdint>
 #include <vector>
@@ -7,6 +8,8 @@
 
 #include "Camera.h"
 #include "DataTypes.h"
+#include "InstanceBvh.h"
+#include "Scene.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -14,15 +17,38 @@ struct SDL_Surface;
 namespace dae
 {
 	class Texture;
+	class HiZBuffer;
+	class OcclusionBuffer;
+	class JobSystem;
+	class Presenter;
+	struct FramePacingStats;
 	struct Mesh;
+	struct BoundingBox;
 	struct Vertex;
 	class Timer;
-	class Scene;
 
 	class Renderer final
 	{
 	public:
-		Renderer(SDL_Window* pWindow);
+		enum class ShadingMode
+		{
+			ObservedArea,	// Lambert Cosine Law
+			Diffuse,		// Diffuse Color
+			Specular,		// Specular Color
+			Combined		// Diffuse + Specular + Ambient
+		};
+
+		enum class RenderPath
+		{
+			Forward,		// Shade every fragment that passes the depth test
+			Deferred,		// Rasterize into the G-buffer first, then shade every visible pixel once
+			VisibilityBuffer,// Rasterize only triangle IDs, the resolve pass recomputes the barycentrics
+			DepthPrePass	// Rasterize depth only first, then shade only the fragments that match the final depth
+		};
+
+		static constexpr const char* DefaultSceneFile{ "resources/vehicle.scene" };
+
+		explicit Renderer(SDL_Window* pWindow, const std::string& sceneFile = DefaultSceneFile);
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
@@ -35,48 +61,333 @@ namespace dae
 
 		bool SaveBufferToImage() const;
 
+		// Measured on the present thread, see Presenter
+		FramePacingStats GetFramePacingStats() const;
+		void ResetFramePacingStats();
+
 		void CycleShadingMode();
+		void CycleRenderPath();
 		void ToggleDepthBufferVisualization()	{ m_DepthBufferVisualization = !m_DepthBufferVisualization; }
 		void ToggleMeshRotation()				{ m_RotateMesh = !m_RotateMesh; }
 		void ToggleNormalMap()					{ m_UseNormalMap = !m_UseNormalMap; }
 		void ToggleWireFrames()					{ m_DrawWireFrames = !m_DrawWireFrames; }
+		void ToggleDepthSorting()				{ m_SortFrontToBack = !m_SortFrontToBack; }
+		void ToggleHiZ()						{ m_UseHiZ = !m_UseHiZ; }
+		void ToggleOcclusionCulling()			{ m_UseOcclusionCulling = !m_UseOcclusionCulling; }
+		void ToggleFrustumCulling()				{ m_UseFrustumCulling = !m_UseFrustumCulling; }
+		void ToggleMeshletCulling()				{ m_UseMeshletCulling = !m_UseMeshletCulling; }
+		void ToggleLods()						{ m_UseLods = !m_UseLods; }
+		// More frames per second, but what is shown lags one frame behind the camera and the scene
+		void TogglePipelinedFrames()			{ m_PipelineFrames = !m_PipelineFrames; }
+		// Shaded colors go to a float buffer and are tonemapped afterwards, instead of being clamped to 8 bits per pixel
+		void ToggleHdr()						{ m_UseHdr = !m_UseHdr; }
+
+		Camera& GetCamera()						{ return m_Camera; }
+		std::vector<MeshHandle>& GetMeshes()	{ return m_vMeshes; }
+		std::vector<MeshInstance>& GetInstances(){ return m_vInstances; }
+		ResourceManager& GetResourceManager()	{ return m_ResourceManager; }
+		Scene& GetScene()						{ return m_Scene; }
+
+		// Adds the meshes, nodes and instances of a scene file (see SceneFile.h), its camera and light replace the current ones
+		void LoadScene(const std::string& path);
+
+		// Meshes are only stored once, returns the index the instances refer to
+		uint32_t AddMesh(Mesh&& mesh);
+		uint32_t AddMesh(const MeshHandle& mesh);
+		// One instance per world matrix, all sharing the vertices, indices and textures of the mesh. Every instance gets a root node
+		// in the scene that owns its world matrix. Returns the index of the first one
+		uint32_t AddMeshInstances(uint32_t mesh, const std::vector<Matrix>& worldMatrices, const ColorRGB& tint = colors::White);
 
-		void ProjectMeshToNDC(Mesh& mesh) const;
 		void RasterizeVertex(Vertex_Out& vertex) const;
-		void InterpolateDepths(float& zDepth, float& wDepth, const std::array<Vertex_Out, 3>& triangle, const Vector3& weights);
-		void InterpolateAllAttributes(const std::array<Vertex_Out, 3>& triangle, const Vector3& weights, const float wInterpolated, Vertex_Out& output);
+		void RasterizeVertex(Vector4& position) const;
+		void InterpolateDepths(float& zDepth, float& wDepth, const std::array<Vertex_Out, 3>& triangle, const Vector3& weights) const;
+		template<ShadingMode Mode, bool UseNormalMap>
+		void InterpolateAttributes(const std::array<Vertex_Out, 3>& triangle, const Vector3& weights, const float wInterpolated, Vertex_Out& output) const;
 		
-		ColorRGB PixelShading(const Vertex_Out& v, Mesh& m);
+		template<ShadingMode Mode, bool UseNormalMap>
+		ColorRGB PixelShading(const Vertex_Out& v, const Mesh& m) const;
 
 		void DrawLine(int x0, int y0, int x1, int y1, const ColorRGB& color);
 	private:
-		enum class ShadingMode
+		// Instance and triangle index packed into 32 bits, enough for 4096 instances of 1M triangles each.
+		// The last triangle index is left out, so no ID can equal EmptyVisibilityId
+		static constexpr uint32_t VisibilityTriangleBits{ 20 };
+		static constexpr uint32_t VisibilityTriangleMask{ (1u << VisibilityTriangleBits) - 1 };
+		static constexpr uint32_t MaxVisibilityInstances{ 1u << (32 - VisibilityTriangleBits) };
+		static constexpr uint32_t EmptyVisibilityId{ UINT32_MAX };
+		static uint32_t PackVisibilityId(uint32_t instanceIndex, uint32_t triangleIndex)
 		{
-			ObservedArea,	// Lambert Cosine Law
-			Diffuse,		// Diffuse Color
-			Specular,		// Specular Color
-			Combined		// Diffuse + Specular + Ambient
+			assert(instanceIndex < MaxVisibilityInstances and triangleIndex < VisibilityTriangleMask && "Renderer::PackVisibilityId > Index doesn't fit the ID");
+			return (instanceIndex << VisibilityTriangleBits) | triangleIndex;
+		}
+		// False when there are more instances or triangles than the IDs can hold, the deferred and visibility buffer paths then fall back to forward
+		bool CanPackVisibilityIds() const;
+
+		// What the deferred raster pass stores per pixel, the third barycentric weight follows from the other two
+		struct GBufferSample
+		{
+			uint32_t visibilityId{ EmptyVisibilityId };
+			float weight0{};
+			float weight1{};
+		};
+
+		enum class DepthTest
+		{
+			LessEqual,		// Regular depth test, also writes the depth buffer
+			Equal			// After a depth pre-pass, leaves the depth buffer as is
+		};
+
+		// A frame has a front end, which decides what is drawn (instance culling, sorting, levels of detail), and a back end,
+		// which draws it (meshlet culling, vertex stage, rasterization, shading and present). With pipelining the front end of
+		// the next frame runs while the back end still draws the last one, the hand over in between copies what the back end reads
+		void PrepareFrame();
+		void HandOverFrame();
+		void DrawFrame();
+
+		void RenderForward();
+		void RenderDepthPrePass();
+		template<RenderPath Path>
+		void RenderVisibilityPasses();
+
+		// Every combination of settings gets its own instantiation of the tile loop, chosen once per frame
+		using RasterizeBinsFunction = void (Renderer::*)();
+		template<DepthTest Test>
+		RasterizeBinsFunction SelectShadeBinsFunction() const;
+		template<DepthTest Test, ShadingMode Mode, bool UseNormalMap, bool DepthVisualization>
+		void ShadeBins();
+		void RasterizeBinsDepth();
+		// Lines aren't binned, they go straight into the back buffer
+		void RenderMeshWireFrames(MeshInstance& instance);
+
+		// Raster and shading passes of the deferred and visibility buffer paths
+		template<RenderPath Path>
+		void RasterizeBinsVisibility();
+		using ShadePassFunction = void (Renderer::*)();
+		template<RenderPath Path>
+		ShadePassFunction SelectShadePassFunction() const;
+		template<RenderPath Path, ShadingMode Mode, bool UseNormalMap, bool DepthVisualization>
+		void ShadeVisiblePixels();
+
+		// Screen space binning, the triangles of a batch are set up in submission order and added to the bins of the Hi-Z tiles they
+		// overlap. The bins are then rasterized on the job system, a tile's depth, color and clear state only ever see the task that
+		// owns its bin, and within the tile the triangles still land in submission order
+		struct BinnedTriangle
+		{
+			std::array<Vector4, 3> positions{};		// Raster space
+			std::array<uint32_t, 3> vertexSlots{};	// Where the attributes are in vertices_out
+			uint32_t instanceIndex{};
+			uint32_t triangleIndex{};
+			// The pixels whose center can be covered, the maximum is exclusive
+			int minX{};
+			int minY{};
+			int maxX{};
+			int maxY{};
+			float minDepth{};
+			float invArea{};
 		};
+		// The bins are rasterized whenever BinnedTriangleBudget triangles are waiting, so the Hi-Z the binning rejects against stays
+		// recent, and by finishBatch after every vertex batch
+		static constexpr size_t BinnedTriangleBudget{ 4096 };
+		template<DepthTest Test>
+		void BinTriangles(const MeshInstance& instance, uint32_t instanceIndex, RasterizeBinsFunction rasterizeBins);
+		// False if the triangle covers no pixel center
+		bool CalculateTriangleBounds(BinnedTriangle& triangle) const;
+		// Calls rasterizeTriangle(triangle, tileX, tileY) for every binned triangle in every tile it was binned in, which returns
+		// true if it wrote depth. Empties the bins and refreshes the Hi-Z afterwards
+		template<DepthTest Test, typename TriangleFunction>
+		void RasterizeBins(TriangleFunction&& rasterizeTriangle);
+		// Early-z, coverage and depth test for the pixels of one tile, calls onFragment(pixelIndex, barycentric, z, w) for every visible pixel
+		template<DepthTest Test, typename FragmentFunction>
+		bool RasterizeTriangleTile(const BinnedTriangle& triangle, int tileX, int tileY, FragmentFunction&& onFragment);
+		template<ShadingMode Mode, bool UseNormalMap, bool DepthVisualization>
+		ColorRGB ShadeFragment(const std::array<Vertex_Out, 3>& triangle, const Vector3& weights, float zBufferValue, float wInterpolated, const MeshInstance& instance) const;
+		void WriteShadedPixel(int pixelIndex, const ColorRGB& finalColor);
+
+		// Where the channels go in a back buffer pixel, read from its SDL format once instead of SDL_MapRGB looking it up for every pixel
+		struct PixelLayout
+		{
+			uint32_t redShift{};
+			uint32_t greenShift{};
+			uint32_t blueShift{};
+			uint32_t alphaMask{};
+		};
+		uint32_t PackColor(const ColorRGB& color) const;
+		// Filmic tonemap and gamma encode of a linear HDR color
+		uint32_t TonemapColor(const ColorRGB& color) const;
+		// Red, green and blue in the three low bytes moved to where the back buffer wants them
+		uint32_t LayoutPixel(uint32_t bytes) const;
+
+		// The HDR buffer is resolved into the back buffer in bands of HdrResolveRows rows, one job system task each.
+		// The visibility and deferred paths resolve every row as soon as it is shaded instead
+		static constexpr int HdrResolveRows{ 16 };
+		void ResolveHdrRows(int firstRow, int lastRow);
+		void ResolveHdrBuffer();
+
+		// The buffers are cleared per Hi-Z tile, right before the first triangle or line is drawn in it. Tiles nothing was drawn in
+		// keep whatever the back buffer held, ClearUntouchedTiles gives those the clear color unless it is already there
+		static constexpr uint32_t ClearColor{ 0x646464 };
+		void EnsureTileCleared(int tileX, int tileY);
+		void ClearTile(int tileX, int tileY);
+		void ClearUntouchedTiles();
+
+		int GetTriangleCount(const MeshLod& lod) const;
+
+		// Walks the triangles of the visible meshlets
+		template<typename TriangleFunction>
+		void ForEachTriangle(const MeshInstance& instance, TriangleFunction&& triangleFunction) const;
+		// Refreshing the Hi-Z of a tile after every triangle that wrote depth into it would cost more than it saves
+		static constexpr int HiZUpdateInterval{ 8 };
+
+		// Front to back sorting, per instance and per meshlet
+		uint16_t QuantizeViewDepth(float viewDepth) const;
+		void SortInstancesFrontToBack();
+		void SortMeshlets(MeshInstance& instance);
+
+		// Meshlets outside the frustum, facing away or behind the Hi-Z are dropped before the vertex stage,
+		// which then only transforms the vertices of the ones left
+		void CullMeshlets(MeshInstance& instance);
+		const std::vector<uint32_t>& GetVisibleVertices(const MeshInstance& instance) const;
+
+		// The vertex stage runs for several instances at once, as many as fit in VertexBatchSize vertices.
+		// Their vertices are split in chunks of VertexChunkSize, which are all transformed in one parallel loop
+		enum class VertexStage
+		{
+			All,
+			Positions,
+			Attributes	// After Positions, for the fragments that survived the depth pre-pass
+		};
+		static constexpr size_t VertexBatchSize{ 1 << 16 };
+		static constexpr uint32_t VertexChunkSize{ 512 };
+
+		// Items per job system task, large enough that queueing a task costs little next to running it
+		static constexpr uint32_t MeshletSortGrain{ 64 };
+		static constexpr uint32_t OccluderVertexGrain{ 1024 };
+		static constexpr uint32_t ShadeRowGrain{ 4 };
+		static constexpr uint32_t InstanceSortGrain{ 256 };
+		static constexpr uint32_t RadixSortGrain{ 2048 };
+		static constexpr uint32_t TileBinGrain{ 4 };
+		struct VertexChunk
+		{
+			uint32_t instanceIndex{};
+			uint32_t first{};
+			uint32_t last{};
+		};
+		// Culls the meshlets and runs the vertex stage batch by batch, then calls renderInstance(instance, instanceIndex) for each
+		// and finishBatch() once they all had their turn
+		template<typename InstanceFunction, typename BatchFunction>
+		void ForEachInstanceBatch(VertexStage stage, InstanceFunction&& renderInstance, BatchFunction&& finishBatch);
+		void ProjectInstances(size_t firstOrderIndex, size_t lastOrderIndex, VertexStage stage);
+
+		// World space boxes of the instances in a BVH, only the instances that moved since the last frame are refit
+		void UpdateInstanceBvh();
+		// Instances outside the camera frustum or behind the occluders are dropped before their vertices are transformed.
+		// Whole BVH nodes are rejected at once, only the instances in the leaves that pass are tested one by one
+		void CullInstances();
+		bool IsInstanceInFrustum(const Frustum& frustum, const MeshInstance& instance) const;
+
+		// The coarsest level whose error stays under LodPixelError on screen, judged by the projected bounding sphere.
+		// The hysteresis band keeps a mesh from switching back and forth at the threshold
+		static constexpr float LodPixelError{ 1.f };
+		static constexpr float LodHysteresis{ 0.2f };
+		void SelectInstanceLods();
+
+		// Instances of meshes flagged as occluder are rasterized into a low resolution buffer, the instances behind them are skipped
+		static constexpr int OcclusionBufferScale{ 4 };
+		// Returns false when there is nothing to test against
+		bool RasterizeOccluders();
+		bool IsOccluded(const BoundingBox& bounds, const Matrix& worldViewProjectionMatrix) const;
+		bool CalculateScreenBounds(const BoundingBox& bounds, const Matrix& worldViewProjectionMatrix, Vector2& ndcMin, Vector2& ndcMax, float& minDepth) const;
+
+		// Fills in the raster space positions and vertex slots, false if the triangle is culled
+		bool SetupTriangle(const MeshInstance& instance, int triangleIndex, BinnedTriangle& triangle) const;
+		// The full vertices of a set up triangle, for the passes that shade it
+		void FetchTriangleVertices(const MeshInstance& instance, const BinnedTriangle& triangle, std::array<Vertex_Out, 3>& triangleRasterVertices) const;
+		bool GetTriangleIndices(const MeshLod& lod, int triangleIndex, uint32_t& indexPos0, uint32_t& indexPos1, uint32_t& indexPos2) const;
+		bool ProjectVertexPosition(const Mesh& mesh, MeshInstance& instance, uint32_t index, uint32_t slot) const;
+		void ProjectVertexAttributes(const Mesh& mesh, MeshInstance& instance, uint32_t index, uint32_t slot) const;
+
 		ShadingMode m_CurrentShadingMode	{ ShadingMode::Combined };
+		RenderPath m_CurrentRenderPath		{ RenderPath::Forward };
+		RenderPath m_DrawRenderPath			{ RenderPath::Forward };
 		bool m_DepthBufferVisualization		{ false };
 		bool m_RotateMesh					{ true };
 		bool m_UseNormalMap					{ true };
 		bool m_DrawWireFrames				{ false };
+		bool m_SortFrontToBack				{ false };
+		bool m_UseHiZ						{ true };
+		bool m_UseOcclusionCulling			{ true };
+		bool m_UseFrustumCulling			{ true };
+		bool m_UseMeshletCulling			{ true };
+		bool m_UseLods						{ true };
+		bool m_PipelineFrames				{ true };
+		bool m_UseHdr						{ false };
+		bool m_ResolveHdr					{ false };	// m_UseHdr for the frame being drawn, off for debug output
+		bool m_HasPreparedFrame				{ false };
 
 		SDL_Window* m_pWindow{};
 
-		SDL_Surface* m_pFrontBuffer{ nullptr };
+		// Triple buffered, the renderer only waits for the present thread when it is two frames behind
+		static constexpr uint32_t BackBufferCount{ 3 };
+		std::unique_ptr<Presenter> m_upPresenter{};
 		SDL_Surface* m_pBackBuffer{ nullptr };
 		uint32_t* m_pBackBufferPixels{};
+		PixelLayout m_PixelLayout{};
 
 		float* m_pDepthBufferPixels{};
+		std::unique_ptr<HiZBuffer> m_upHiZBuffer{};
+		std::unique_ptr<OcclusionBuffer> m_upOcclusionBuffer{};
+		std::vector<Vector4> m_vOccluderPositions{};
+		std::vector<GBufferSample> m_vGBuffer{};
+		std::vector<uint32_t> m_vVisibilityBuffer{};
+		// Linear colors of the covered pixels, only written and read while m_ResolveHdr is on
+		std::vector<ColorRGB> m_vHdrBuffer{};
+
+		// One flag per tile, set once the tile was cleared this frame
+		int m_TileCountX{};
+		int m_TileCountY{};
+		std::vector<uint8_t> m_vTileCleared{};
+		// Per back buffer, set for the tiles that hold nothing but the clear color
+		std::vector<std::vector<uint8_t>> m_vClearColorTiles{};
+
+		// The triangles of the batch being drawn, one bin of indices into them per tile and the tiles whose bin isn't empty
+		std::vector<BinnedTriangle> m_vBinnedTriangles{};
+		std::vector<std::vector<uint32_t>> m_vTileBins{};
+		std::vector<uint32_t> m_vBinnedTiles{};
+		std::vector<uint8_t> m_vBinnedTileDepthWritten{};
+
+		std::unique_ptr<JobSystem> m_upJobSystem{};
 
 		Camera m_Camera{};
 		float m_AspectRatio{};
 
+		// The camera and draw order of the frame the back end is drawing
+		Matrix m_RenderViewMatrix{};
+		Matrix m_RenderProjectionMatrix{};
+		Vector3 m_RenderCameraOrigin{};
+		std::vector<uint32_t> m_vRenderOrder{};
+
+		// The one directional light, from the scene file
+		Vector3 m_DirectionToLight{};
+		ColorRGB m_Ambient{};
+
 		int m_Width{};
 		int m_Height{};
 
-		std::vector<Mesh> m_vMeshes;
+		ResourceManager m_ResourceManager{};
+		Scene m_Scene{};
+		std::vector<MeshHandle> m_vMeshes;
+		std::vector<MeshInstance> m_vInstances{};
+		std::vector<uint32_t> m_vInstanceOrder{};
+		std::vector<uint16_t> m_vInstanceSortKeys{};
+		std::vector<uint32_t> m_vInstanceSortScratch{};
+		std::vector<std::array<uint32_t, 256>> m_vInstanceSortHistograms{};
+		InstanceBvh m_InstanceBvh{};
+		std::vector<BoundingBox> m_vInstanceBounds{};
+		std::vector<uint32_t> m_vMovedInstances{};
+		std::vector<VertexChunk> m_vVertexChunks{};
+		std::vector<uint16_t> m_vSortKeys{};
+		std::vector<uint32_t> m_vSortScratch{};
+		std::vector<std::array<uint32_t, 256>> m_vSortHistograms{};
+		std::vector<uint8_t> m_vVertexMarks{};
 	};
 }
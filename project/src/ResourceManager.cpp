@@ -0,0 +1,113 @@
+#include "ResourceManager.h"
+#include "Texture.h"
+#include "Utils.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace dae
+{
+	namespace
+	{
+		std::string GetCanonicalPath(const std::string& path)
+		{
+			// Also resolves files that don't exist, those fail once they are read
+			std::error_code error{};
+			const std::filesystem::path canonicalPath = std::filesystem::weakly_canonical(path, error);
+			return error ? path : canonicalPath.string();
+		}
+
+		std::vector<char> ReadFile(const std::string& path)
+		{
+			std::ifstream file(path, std::ios::binary);
+			if (!file)
+			{
+				std::cerr << "ResourceManager > Failed to open: " << path << std::endl;
+				throw std::runtime_error("Failed to open resource");
+			}
+			return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+		}
+
+		// FNV-1a, the size goes in as well so files that only differ in length never share a key
+		uint64_t HashContent(const std::vector<char>& data)
+		{
+			uint64_t hash{ 14695981039346656037ull };
+			for (char byte : data)
+			{
+				hash ^= uint8_t(byte);
+				hash *= 1099511628211ull;
+			}
+			return hash ^ (uint64_t(data.size()) * 0x9E3779B97F4A7C15ull);
+		}
+	}
+
+	template<typename Resource, typename DecodeFunction>
+	std::shared_ptr<Resource> ResourceManager::Load(Cache<Resource>& cache, const std::string& path, DecodeFunction&& decode)
+	{
+		const std::string canonicalPath = GetCanonicalPath(path);
+		{
+			std::lock_guard lock{ cache.mutex };
+			if (const auto pathIt = cache.contentHashes.find(canonicalPath); pathIt != cache.contentHashes.end())
+				return cache.resources.at(pathIt->second);
+		}
+
+		const std::vector<char> data = ReadFile(canonicalPath);
+		const uint64_t contentHash = HashContent(data);
+		{
+			std::lock_guard lock{ cache.mutex };
+			if (const auto resourceIt = cache.resources.find(contentHash); resourceIt != cache.resources.end())
+			{
+				cache.contentHashes.emplace(canonicalPath, contentHash);
+				return resourceIt->second;
+			}
+		}
+
+		// Nothing is cached when decoding throws
+		std::shared_ptr<Resource> resource = decode(data, canonicalPath);
+
+		std::lock_guard lock{ cache.mutex };
+		cache.contentHashes.emplace(canonicalPath, contentHash);
+		return cache.resources.try_emplace(contentHash, std::move(resource)).first->second;
+	}
+
+	TextureHandle ResourceManager::LoadTexture(const std::string& path)
+	{
+		return Load(m_TextureCache, path, [](const std::vector<char>& data, const std::string& name)
+			{
+				return TextureHandle(Texture::LoadFromMemory(data, name));
+			});
+	}
+
+	MeshHandle ResourceManager::LoadMesh(const std::string& path)
+	{
+		return Load(m_MeshCache, path, [](const std::vector<char>& data, const std::string& name)
+			{
+				MeshHandle mesh = std::make_shared<Mesh>();
+				MeshLod& lod = mesh->lods[0];
+				std::istringstream stream(std::string(data.begin(), data.end()));
+				if (!Utils::ParseOBJ(stream, mesh->vertices, lod.indices, lod.vertexCounter, mesh->bounds, mesh->boundingSphere))
+				{
+					std::cerr << "ResourceManager::LoadMesh > Failed to parse: " << name << std::endl;
+					throw std::runtime_error("Failed to load mesh");
+				}
+				lod.primitiveTopology = PrimitiveTopology::TriangleList;
+				BuildLods(*mesh);
+				BuildMeshlets(*mesh);
+				return mesh;
+			});
+	}
+
+	void ResourceManager::ReleaseUnused()
+	{
+		auto release = [](auto& cache)
+			{
+				std::lock_guard lock{ cache.mutex };
+				std::erase_if(cache.resources, [](const auto& entry) { return entry.second.use_count() == 1; });
+				std::erase_if(cache.contentHashes, [&](const auto& entry) { return !cache.resources.contains(entry.second); });
+			};
+		release(m_TextureCache);
+		release(m_MeshCache);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dae
+{
+	class Texture;
+	struct Mesh;
+
+	// Ref-counted, every user of an asset holds the same one
+	using TextureHandle = std::shared_ptr<const Texture>;
+	using MeshHandle = std::shared_ptr<Mesh>;
+
+	// Loads every asset once. Paths are resolved to their canonical form first, a path that was not seen before is read
+	// and hashed, so the same content behind another path (a copy, another extension) is shared as well.
+	// The cache holds its own reference, assets stay loaded until ReleaseUnused.
+	// Loads may run on several threads at once, files are read and decoded outside the lock
+	class ResourceManager final
+	{
+	public:
+		TextureHandle LoadTexture(const std::string& path);
+		// OBJ with its levels of detail and meshlets built. Every user gets the same mesh, so whoever needs another cull mode
+		// or other textures than the ones already set has to copy it (see Renderer::LoadScene)
+		MeshHandle LoadMesh(const std::string& path);
+
+		// Drops the assets nothing but the cache still references
+		void ReleaseUnused();
+
+		size_t GetTextureCount() const	{ return m_TextureCache.resources.size(); }
+		size_t GetMeshCount() const		{ return m_MeshCache.resources.size(); }
+
+	private:
+		template<typename Resource>
+		struct Cache
+		{
+			std::unordered_map<std::string, uint64_t> contentHashes{}; // Canonical path to content hash
+			std::unordered_map<uint64_t, std::shared_ptr<Resource>> resources{};
+			std::mutex mutex{};
+		};
+
+		// Only decodes when neither the path nor the content is cached yet, two threads racing for the same content both
+		// decode it and the first one to finish is kept
+		template<typename Resource, typename DecodeFunction>
+		std::shared_ptr<Resource> Load(Cache<Resource>& cache, const std::string& path, DecodeFunction&& decode);
+
+		Cache<const Texture> m_TextureCache{};
+		Cache<Mesh> m_MeshCache{};
+	};
+}
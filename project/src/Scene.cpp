@@ -0,0 +1,62 @@
+#include "Scene.h"
+#include "DataTypes.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace dae
+{
+	uint32_t Scene::AddNode(const std::string& name, uint32_t parent, const Matrix& localMatrix)
+	{
+		const uint32_t node = uint32_t(m_vParents.size());
+		assert((parent == NoParent or parent < node) && "Scene::AddNode > The parent has to be added first");
+
+		m_vNames.emplace_back(name);
+		m_vParents.emplace_back(parent);
+		m_vLocalMatrices.emplace_back(localMatrix);
+		m_vWorldMatrices.emplace_back(localMatrix);
+		m_vDirty.emplace_back(true);
+		m_vInstances.emplace_back(NoInstance);
+		m_vSpinSpeeds.emplace_back(0.f);
+		return node;
+	}
+
+	uint32_t Scene::FindNode(const std::string& name) const
+	{
+		const auto nameIt = std::find(m_vNames.begin(), m_vNames.end(), name);
+		return nameIt != m_vNames.end() ? uint32_t(nameIt - m_vNames.begin()) : NoParent;
+	}
+
+	void Scene::SetLocalMatrix(uint32_t node, const Matrix& localMatrix)
+	{
+		m_vLocalMatrices[node] = localMatrix;
+		m_vDirty[node] = true;
+	}
+
+	void Scene::Animate(float elapsedSeconds)
+	{
+		for (uint32_t node{}; node < m_vSpinSpeeds.size(); ++node)
+		{
+			if (m_vSpinSpeeds[node] == 0.f) continue;
+			SetLocalMatrix(node, Matrix::CreateRotationY(m_vSpinSpeeds[node] * elapsedSeconds) * m_vLocalMatrices[node]);
+		}
+	}
+
+	void Scene::UpdateWorldMatrices(std::vector<MeshInstance>& instances, std::vector<uint32_t>& movedInstances)
+	{
+		// Parents come first, so a dirty parent has already passed its flag on by the time its children are reached
+		for (uint32_t node{}; node < m_vParents.size(); ++node)
+		{
+			const uint32_t parent = m_vParents[node];
+			if (parent != NoParent) m_vDirty[node] |= m_vDirty[parent];
+			if (!m_vDirty[node]) continue;
+
+			m_vWorldMatrices[node] = parent == NoParent ? m_vLocalMatrices[node] : m_vLocalMatrices[node] * m_vWorldMatrices[parent];
+			const uint32_t instance = m_vInstances[node];
+			if (instance == NoInstance) continue;
+			instances[instance].worldMatrix = m_vWorldMatrices[node];
+			movedInstances.emplace_back(instance);
+		}
+		std::fill(m_vDirty.begin(), m_vDirty.end(), uint8_t(false));
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Matrix.h"
+
+namespace dae
+{
+	struct MeshInstance;
+
+	// Flat scene graph. Nodes are stored in arrays in the order they were added and a parent always comes before its
+	// children, so the world matrices are brought up to date in one forward pass. Only nodes whose local matrix changed,
+	// and everything below them, are recomputed
+	class Scene final
+	{
+	public:
+		static constexpr uint32_t NoParent{ UINT32_MAX };
+		static constexpr uint32_t NoInstance{ UINT32_MAX };
+
+		uint32_t AddNode(const std::string& name, uint32_t parent, const Matrix& localMatrix);
+		// First node with the name, NoParent if there is none
+		uint32_t FindNode(const std::string& name) const;
+		size_t GetNodeCount() const								{ return m_vParents.size(); }
+
+		void SetLocalMatrix(uint32_t node, const Matrix& localMatrix);
+		const Matrix& GetLocalMatrix(uint32_t node) const		{ return m_vLocalMatrices[node]; }
+		// Only valid after UpdateWorldMatrices
+		const Matrix& GetWorldMatrix(uint32_t node) const		{ return m_vWorldMatrices[node]; }
+
+		// The instance follows the node, its world matrix is written whenever the node's changes
+		void SetInstance(uint32_t node, uint32_t instance)		{ m_vInstances[node] = instance; m_vDirty[node] = true; }
+		uint32_t GetInstance(uint32_t node) const				{ return m_vInstances[node]; }
+
+		// Turns the node around its own Y axis, in radians per second
+		void SetSpinSpeed(uint32_t node, float radiansPerSecond)	{ m_vSpinSpeeds[node] = radiansPerSecond; }
+		void Animate(float elapsedSeconds);
+
+		// Writes the world matrices of the instances whose node changed and appends their indices to movedInstances
+		void UpdateWorldMatrices(std::vector<MeshInstance>& instances, std::vector<uint32_t>& movedInstances);
+
+	private:
+		std::vector<std::string> m_vNames{};
+		std::vector<uint32_t> m_vParents{};
+		std::vector<Matrix> m_vLocalMatrices{};
+		std::vector<Matrix> m_vWorldMatrices{};
+		std::vector<uint8_t> m_vDirty{};
+		std::vector<uint32_t> m_vInstances{};
+		std::vector<float> m_vSpinSpeeds{};
+	};
+}
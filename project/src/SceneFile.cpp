@@ -0,0 +1,156 @@
+#include "SceneFile.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace dae
+{
+	namespace
+	{
+		template<typename Entry>
+		int FindEntry(const std::vector<Entry>& entries, const std::string& name)
+		{
+			for (int index{}; index < int(entries.size()); ++index)
+			{
+				if (entries[index].name == name) return index;
+			}
+			return -1;
+		}
+
+		bool ReadVector(std::istream& stream, Vector3& vector)
+		{
+			return bool(stream >> vector.x >> vector.y >> vector.z);
+		}
+
+		bool ReadColor(std::istream& stream, ColorRGB& color)
+		{
+			return bool(stream >> color.r >> color.g >> color.b);
+		}
+
+		// Relative to the folder of the scene file, so scenes can be loaded from anywhere
+		std::string ResolvePath(const std::filesystem::path& sceneFolder, const std::string& path)
+		{
+			return path == "-" ? std::string{} : (sceneFolder / path).string();
+		}
+	}
+
+	bool ParseSceneFile(const std::string& path, SceneDescription& scene)
+	{
+		std::ifstream file(path);
+		if (!file)
+		{
+			std::cerr << "ParseSceneFile > Failed to open: " << path << std::endl;
+			return false;
+		}
+
+		const std::filesystem::path sceneFolder = std::filesystem::path(path).parent_path();
+		scene = {};
+
+		std::string line{};
+		int lineNumber{};
+		while (std::getline(file, line))
+		{
+			++lineNumber;
+			const auto error = [&](const std::string& message)
+				{
+					std::cerr << "ParseSceneFile > " << path << ":" << lineNumber << " " << message << std::endl;
+					return false;
+				};
+
+			std::istringstream stream(line.substr(0, line.find('#')));
+			std::string command{};
+			if (!(stream >> command)) continue;
+
+			if (command == "camera")
+			{
+				SceneDescription::CameraEntry& camera = scene.camera;
+				if (!ReadVector(stream, camera.origin) or !(stream >> camera.fovAngle >> camera.near >> camera.far))
+					return error("expected camera <x> <y> <z> <fov> <near> <far>");
+			}
+			else if (command == "light")
+			{
+				if (!ReadVector(stream, scene.lightDirection)) return error("expected light <x> <y> <z>");
+			}
+			else if (command == "ambient")
+			{
+				if (!ReadColor(stream, scene.ambient)) return error("expected ambient <r> <g> <b>");
+			}
+			else if (command == "material")
+			{
+				SceneDescription::MaterialEntry material{};
+				std::string diffuse{}, normal{}, gloss{}, specular{};
+				if (!(stream >> material.name >> diffuse >> normal >> gloss >> specular))
+					return error("expected material <name> <diffuse> <normal> <gloss> <specular>");
+				material.diffusePath = ResolvePath(sceneFolder, diffuse);
+				material.normalPath = ResolvePath(sceneFolder, normal);
+				material.glossPath = ResolvePath(sceneFolder, gloss);
+				material.specularPath = ResolvePath(sceneFolder, specular);
+				scene.materials.emplace_back(std::move(material));
+			}
+			else if (command == "mesh")
+			{
+				SceneDescription::MeshEntry mesh{};
+				std::string meshPath{};
+				if (!(stream >> mesh.name >> meshPath)) return error("expected mesh <name> <obj>");
+				mesh.path = ResolvePath(sceneFolder, meshPath);
+
+				std::string option{};
+				while (stream >> option)
+				{
+					std::string value{};
+					if (!(stream >> value)) return error("missing value for " + option);
+					if (option == "material")
+					{
+						mesh.material = FindEntry(scene.materials, value);
+						if (mesh.material < 0) return error("unknown material " + value);
+					}
+					else if (option == "cull")
+					{
+						if (value == "back") mesh.cullMode = CullMode::Back;
+						else if (value == "front") mesh.cullMode = CullMode::Front;
+						else if (value == "none") mesh.cullMode = CullMode::None;
+						else return error("unknown cull mode " + value);
+					}
+					else return error("unknown mesh option " + option);
+				}
+				scene.meshes.emplace_back(std::move(mesh));
+			}
+			else if (command == "node")
+			{
+				SceneDescription::NodeEntry node{};
+				std::string parent{}, mesh{};
+				if (!(stream >> node.name >> parent >> mesh)) return error("expected node <name> <parent> <mesh>");
+				if (parent != "-")
+				{
+					node.parent = FindEntry(scene.nodes, parent);
+					if (node.parent < 0) return error("unknown parent " + parent);
+				}
+				if (mesh != "-")
+				{
+					node.mesh = FindEntry(scene.meshes, mesh);
+					if (node.mesh < 0) return error("unknown mesh " + mesh);
+				}
+
+				Vector3 position{}, rotation{}, scale{ 1.f, 1.f, 1.f };
+				std::string option{};
+				while (stream >> option)
+				{
+					bool isValid{};
+					if (option == "position") isValid = ReadVector(stream, position);
+					else if (option == "rotation") isValid = ReadVector(stream, rotation);
+					else if (option == "scale") isValid = ReadVector(stream, scale);
+					else if (option == "tint") isValid = ReadColor(stream, node.tint);
+					else if (option == "spin") isValid = bool(stream >> node.spinSpeed);
+					else return error("unknown node option " + option);
+					if (!isValid) return error("missing value for " + option);
+				}
+				node.localMatrix = Matrix::CreateScale(scale) * Matrix::CreateRotation(rotation * TO_RADIANS) * Matrix::CreateTranslation(position);
+				scene.nodes.emplace_back(std::move(node));
+			}
+			else return error("unknown command " + command);
+		}
+		return true;
+	}
+}
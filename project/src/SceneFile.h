@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Plain text, one entry per line and # starts a comment. Paths are relative to the scene file, - means none
+	//	camera <x> <y> <z> <fov degrees> <near> <far>
+	//	light <direction x> <y> <z>							Directional, the shading only has one so the last one wins
+	//	ambient <r> <g> <b>
+	//	material <name> <diffuse> <normal> <gloss> <specular>
+	//	mesh <name> <obj> [material <name>] [cull back|front|none]
+	//	node <name> <parent> <mesh> [position <x> <y> <z>] [rotation <pitch> <yaw> <roll>] [scale <x> <y> <z>] [tint <r> <g> <b>] [spin <radians/s>]
+	// Rotations are in degrees, parents, meshes and materials have to be declared before they are used
+	struct SceneDescription
+	{
+		struct CameraEntry
+		{
+			Vector3 origin{ 0.f, 5.f, -64.f };
+			float fovAngle{ 45.f };
+			float near{ 0.1f };
+			float far{ 100.f };
+		};
+
+		struct MaterialEntry
+		{
+			std::string name{};
+			std::string diffusePath{};
+			std::string normalPath{};
+			std::string glossPath{};
+			std::string specularPath{};
+		};
+
+		struct MeshEntry
+		{
+			std::string name{};
+			std::string path{};
+			int material{ -1 };
+			CullMode cullMode{ CullMode::Back };
+		};
+
+		struct NodeEntry
+		{
+			std::string name{};
+			int parent{ -1 };
+			int mesh{ -1 };
+			Matrix localMatrix{};
+			ColorRGB tint{ colors::White };
+			float spinSpeed{};
+		};
+
+		CameraEntry camera{};
+		Vector3 lightDirection{ 0.577f, -0.577f, 0.577f };
+		ColorRGB ambient{ 0.03f, 0.03f, 0.03f };
+		std::vector<MaterialEntry> materials{};
+		std::vector<MeshEntry> meshes{};
+		// Parents always come before their children
+		std::vector<NodeEntry> nodes{};
+	};
+
+	// Prints the offending line and returns false if the file can't be read or has an error
+	bool ParseSceneFile(const std::string& path, SceneDescription& scene);
+}
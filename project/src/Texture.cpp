@@ -32,6 +32,18 @@ namespace dae
 		return new Texture(pSurface);
 	}
 
+	Texture* Texture::LoadFromMemory(const std::vector<char>& data, const std::string& name)
+	{
+		SDL_Surface* pSurface = IMG_Load_RW(SDL_RWFromConstMem(data.data(), int(data.size())), 1);
+		if (pSurface == nullptr)
+		{
+			std::cerr << "Texture::LoadFromMemory > Failed to load texture: " << name << " Error: " << IMG_GetError() << std::endl;
+			throw std::runtime_error("Failed to load texture");
+		}
+
+		return new Texture(pSurface);
+	}
+
 	ColorRGB Texture::Sample(const Vector2& uv) const
 	{
 		// Set the default return color to black
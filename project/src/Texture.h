@@ -1,6 +1,7 @@
 #pragma once
 #include <SDL_surface.h>
 #include <string>
+#include <vector>
 #include "ColorRGB.h"
 
 namespace dae
@@ -13,6 +14,8 @@ namespace dae
 		~Texture();
 
 		static Texture* LoadFromFile(const std::string& path);
+		// Decodes a file that was already read, the name is only used in errors
+		static Texture* LoadFromMemory(const std::vector<char>& data, const std::string& name);
 		ColorRGB Sample(const Vector2& uv) const;
 
 	private:
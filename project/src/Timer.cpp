@@ -1,5 +1,9 @@
 #include "Timer.h"
 #include "SDL.h"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
 using namespace dae;
 
 Timer::Timer()
@@ -60,6 +64,16 @@ void Timer::Update()
 
 	m_TotalTime = (float)(((m_CurrentTime - m_PausedTime) - m_BaseTime) * m_SecondsPerCount);
 
+	//BENCHMARK LOGIC
+	if (m_BenchmarkActive)
+	{
+		m_Benchmarks.push_back(m_ElapsedTime * 1000.f);
+		if (int(m_Benchmarks.size()) >= m_BenchmarkFrames)
+			EndBenchmark();
+		else
+			m_ElapsedTime = m_BenchmarkTimeStep;
+	}
+
 	//FPS LOGIC
 	m_FPSTimer += m_ElapsedTime;
 	++m_FPSCount;
@@ -82,3 +96,45 @@ void Timer::Stop()
 		m_IsStopped = true;
 	}
 }
+
+void Timer::StartBenchmark(int numFrames, float fixedTimeStep)
+{
+	if (m_BenchmarkActive)
+	{
+		std::cout << "(Benchmark already running)\n";
+		return;
+	}
+
+	m_BenchmarkActive = true;
+	m_BenchmarkFrames = std::max(numFrames, 1);
+	m_BenchmarkTimeStep = fixedTimeStep;
+	m_BenchmarkAvg = 0.0f;
+	m_ElapsedTime = fixedTimeStep; // The first benchmarked frame is simulated before the next Update
+
+	m_Benchmarks.clear();
+	m_Benchmarks.reserve(m_BenchmarkFrames);
+
+	std::cout << "**BENCHMARK STARTED** (" << m_BenchmarkFrames << " frames)\n";
+}
+
+void Timer::EndBenchmark()
+{
+	m_BenchmarkActive = false;
+
+	// The first frame still pays for warming up caches and threads, leave it out when there is enough data
+	auto first = m_Benchmarks.size() > 1 ? m_Benchmarks.begin() + 1 : m_Benchmarks.begin();
+	std::vector<float> frameTimes{ first, m_Benchmarks.end() };
+	std::sort(frameTimes.begin(), frameTimes.end());
+
+	m_BenchmarkAvg = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0f) / frameTimes.size();
+	const float median = frameTimes[frameTimes.size() / 2];
+	const float p99 = frameTimes[std::min(frameTimes.size() - 1, frameTimes.size() * 99 / 100)];
+
+	std::cout << "**BENCHMARK FINISHED**\n";
+	std::cout << ">> FRAMES = " << frameTimes.size() << "\n";
+	std::cout << ">> AVG    = " << m_BenchmarkAvg << " ms (" << 1000.f / m_BenchmarkAvg << " FPS)\n";
+	std::cout << ">> MEDIAN = " << median << " ms\n";
+	std::cout << ">> LOW    = " << frameTimes.front() << " ms\n";
+	std::cout << ">> HIGH   = " << frameTimes.back() << " ms\n";
+	std::cout << ">> P99    = " << p99 << " ms\n";
+}
@@ -2,6 +2,7 @@
 
 //Standard includes
 #include <cstdint>
+#include <vector>
 
 namespace dae
 {
@@ -21,6 +22,12 @@ namespace dae
 		void Update();
 		void Stop();
 
+		// Records the next numFrames frame times and prints a summary once they are done.
+		// While running, GetElapsed returns a fixed time step so every benchmark run simulates the same frames.
+		void StartBenchmark(int numFrames = 500, float fixedTimeStep = 1.f / 60.f);
+		bool IsBenchmarkRunning() const { return m_BenchmarkActive; };
+		float GetBenchmarkAverage() const { return m_BenchmarkAvg; };
+
 		uint32_t GetFPS() const { return m_FPS; };
 		float GetdFPS() const { return m_dFPS; };
 		float GetElapsed() const { return m_ElapsedTime; };
@@ -46,5 +53,14 @@ namespace dae
 
 		bool m_IsStopped = true;
 		bool m_ForceElapsedUpperBound = false;
+
+		// Benchmark, all times in milliseconds
+		bool m_BenchmarkActive = false;
+		int m_BenchmarkFrames = 0;
+		float m_BenchmarkTimeStep = 0.0f;
+		float m_BenchmarkAvg = 0.0f;
+		std::vector<float> m_Benchmarks{};
+
+		void EndBenchmark();
 	};
 }
\ No newline at end of file
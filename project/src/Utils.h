@@ -1,9 +1,13 @@
 #pragma once
+#include <algorithm>
+#include <array>
 #include <numeric>
 #include <cassert>
 #include <fstream>
 #include "Maths.h"
 #include "DataTypes.h"
+#include "JobSystem.h"
+#include "MeshSimplifier.h"
 
 //#define DISABLE_OBJ
 
@@ -76,9 +80,9 @@ namespace dae
 		}
 
 		// Create aliases for abs, as well as absolute the actual 
-		const float absX = barycentric.x = abs(X);
-		const float absY = barycentric.y = abs(Y);
-		const float absZ = barycentric.z = abs(Z);
+		const float absX = barycentric.x = std::abs(X);
+		const float absY = barycentric.y = std::abs(Y);
+		const float absZ = barycentric.z = std::abs(Z);
 
 		// Check if they are within the valid range of 0-1
 		if (absX < 0.f or absX > 1.f) return false;
@@ -104,6 +108,13 @@ namespace dae
 		if (positionNDC.z < 0  or positionNDC.z > 1) return false;
 		return true;
 	}
+	inline bool IsNDCTriangleInFrustum(const Vector4& positionNDC)
+	{
+		if (positionNDC.x < -1 or positionNDC.x > 1) return false;
+		if (positionNDC.y < -1 or positionNDC.y > 1) return false;
+		if (positionNDC.z < 0  or positionNDC.z > 1) return false;
+		return true;
+	}
 	inline bool IsNDCTriangleInFrustum(const Vertex_Out& vertex)
 	{
 		Vertex temp;
@@ -113,6 +124,262 @@ namespace dae
 
 		return IsNDCTriangleInFrustum(temp);
 	}
+	inline BoundingBox CalculateBoundingBox(const std::vector<Vertex>& vertices)
+	{
+		BoundingBox bounds{};
+		for (const Vertex& vertex : vertices)
+		{
+			bounds.min = Vector3::Min(bounds.min, vertex.position);
+			bounds.max = Vector3::Max(bounds.max, vertex.position);
+		}
+		return bounds;
+	}
+	inline BoundingSphere CalculateBoundingSphere(const BoundingBox& bounds, const std::vector<Vertex>& vertices)
+	{
+		BoundingSphere sphere{ (bounds.min + bounds.max) * 0.5f, 0.f };
+		float maxSqrDistance{};
+		for (const Vertex& vertex : vertices)
+			maxSqrDistance = std::max(maxSqrDistance, (vertex.position - sphere.center).SqrMagnitude());
+		sphere.radius = std::sqrt(maxSqrDistance);
+		return sphere;
+	}
+	// Greedy, triangles are added in index order until the vertex or triangle limit is hit, so the draw order doesn't change
+	inline void BuildMeshlets(const std::vector<Vertex>& vertices, MeshLod& lod)
+	{
+		lod.meshlets.clear();
+		lod.meshletVertices.clear();
+
+		const bool triangleStrip = lod.primitiveTopology == PrimitiveTopology::TriangleStrip;
+		const int indexJump = triangleStrip ? 1 : 3;
+		const int triangleCount = triangleStrip ? std::max(int(lod.indices.size()) - 2, 0) : int(lod.indices.size() / 3);
+
+		auto getTriangleIndices = [&](uint32_t triangleIndex)
+			{
+				std::array<uint32_t, 3> triangleIndices{ lod.indices[indexJump * triangleIndex], lod.indices[indexJump * triangleIndex + 1], lod.indices[indexJump * triangleIndex + 2] };
+				if (triangleStrip and (triangleIndex & 1)) std::swap(triangleIndices[1], triangleIndices[2]);
+				return triangleIndices;
+			};
+
+		auto finishMeshlet = [&](Meshlet& meshlet)
+			{
+				for (uint32_t vertex{ meshlet.firstVertex }; vertex < meshlet.firstVertex + meshlet.vertexCount; ++vertex)
+				{
+					const Vector3& position = vertices[lod.meshletVertices[vertex]].position;
+					meshlet.bounds.min = Vector3::Min(meshlet.bounds.min, position);
+					meshlet.bounds.max = Vector3::Max(meshlet.bounds.max, position);
+				}
+				meshlet.boundingSphere.center = (meshlet.bounds.min + meshlet.bounds.max) * 0.5f;
+				for (uint32_t vertex{ meshlet.firstVertex }; vertex < meshlet.firstVertex + meshlet.vertexCount; ++vertex)
+				{
+					const float distance = (vertices[lod.meshletVertices[vertex]].position - meshlet.boundingSphere.center).Magnitude();
+					meshlet.boundingSphere.radius = std::max(meshlet.boundingSphere.radius, distance);
+				}
+
+				// Face normals follow the winding, the same one the rasterizer culls on
+				std::vector<Vector3> faceNormals{};
+				Vector3 normalSum{};
+				for (uint32_t triangleIndex{ meshlet.firstTriangle }; triangleIndex < meshlet.firstTriangle + meshlet.triangleCount; ++triangleIndex)
+				{
+					const std::array<uint32_t, 3> triangleIndices = getTriangleIndices(triangleIndex);
+					const Vector3& p0 = vertices[triangleIndices[0]].position;
+					Vector3 faceNormal = Vector3::Cross(vertices[triangleIndices[1]].position - p0, vertices[triangleIndices[2]].position - p0);
+					if (faceNormal.Normalize() <= FLT_EPSILON) continue;
+					faceNormals.emplace_back(faceNormal);
+					normalSum += faceNormal;
+				}
+				if (normalSum.Normalize() <= FLT_EPSILON) return;
+
+				float minDot{ 1.f };
+				for (const Vector3& faceNormal : faceNormals) minDot = std::min(minDot, Vector3::Dot(faceNormal, normalSum));
+				// A cone wider than 90 degrees has normals pointing every way
+				if (minDot <= 0.f) return;
+				meshlet.coneAxis = normalSum;
+				meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+			};
+
+		// Which meshlet last added every vertex
+		std::vector<uint32_t> vertexOwners(vertices.size(), UINT32_MAX);
+		Meshlet meshlet{};
+		for (int triangleIndex{}; triangleIndex < triangleCount; ++triangleIndex)
+		{
+			const std::array<uint32_t, 3> triangleIndices = getTriangleIndices(triangleIndex);
+			const uint32_t meshletIndex = uint32_t(lod.meshlets.size());
+			uint32_t newVertexCount{};
+			for (int corner{}; corner < 3; ++corner)
+			{
+				const bool duplicate = (corner > 0 and triangleIndices[corner] == triangleIndices[0]) or (corner > 1 and triangleIndices[corner] == triangleIndices[1]);
+				if (!duplicate and vertexOwners[triangleIndices[corner]] != meshletIndex) ++newVertexCount;
+			}
+
+			if (meshlet.triangleCount == Meshlet::MaxTriangles or meshlet.vertexCount + newVertexCount > Meshlet::MaxVertices)
+			{
+				finishMeshlet(meshlet);
+				lod.meshlets.emplace_back(meshlet);
+				meshlet = Meshlet{};
+				meshlet.firstTriangle = uint32_t(triangleIndex);
+				meshlet.firstVertex = uint32_t(lod.meshletVertices.size());
+			}
+
+			for (uint32_t index : triangleIndices)
+			{
+				if (vertexOwners[index] == uint32_t(lod.meshlets.size())) continue;
+				vertexOwners[index] = uint32_t(lod.meshlets.size());
+				lod.meshletVertices.emplace_back(index);
+				++meshlet.vertexCount;
+			}
+			++meshlet.triangleCount;
+		}
+		if (meshlet.triangleCount > 0)
+		{
+			finishMeshlet(meshlet);
+			lod.meshlets.emplace_back(meshlet);
+		}
+	}
+	inline void BuildMeshlets(Mesh& mesh)
+	{
+		for (MeshLod& lod : mesh.lods) BuildMeshlets(mesh.vertices, lod);
+	}
+	// Simplified levels of detail, every level has about half the triangles of the one before. Stops early once the borders
+	// and seams keep the simplifier from getting there within maxError (relative to the bounding sphere). Meshlets come after
+	inline void BuildLods(Mesh& mesh, uint32_t maxLevelCount = 4, float maxError = 0.1f)
+	{
+		mesh.lods.resize(1);
+		const MeshLod& fullMesh = mesh.lods[0];
+
+		std::vector<uint32_t> triangleList{ fullMesh.indices };
+		if (fullMesh.primitiveTopology == PrimitiveTopology::TriangleStrip)
+		{
+			triangleList.clear();
+			for (size_t triangleIndex{}; triangleIndex + 2 < fullMesh.indices.size(); ++triangleIndex)
+			{
+				const bool odd = triangleIndex & 1;
+				triangleList.insert(triangleList.end(), { fullMesh.indices[triangleIndex],
+					fullMesh.indices[triangleIndex + (odd ? 2 : 1)], fullMesh.indices[triangleIndex + (odd ? 1 : 2)] });
+			}
+		}
+
+		MeshSimplifier simplifier{ mesh.vertices, triangleList };
+		uint32_t triangleCount{ simplifier.GetTriangleCount() };
+		while (mesh.lods.size() < maxLevelCount)
+		{
+			simplifier.Simplify(triangleCount / 2, maxError * mesh.boundingSphere.radius);
+			if (simplifier.GetTriangleCount() > triangleCount * 3 / 4) break;
+			triangleCount = simplifier.GetTriangleCount();
+
+			MeshLod lod{};
+			lod.indices = simplifier.GetIndices();
+			lod.primitiveTopology = PrimitiveTopology::TriangleList;
+			lod.vertexCounter = lod.indices;
+			std::sort(lod.vertexCounter.begin(), lod.vertexCounter.end());
+			lod.vertexCounter.erase(std::unique(lod.vertexCounter.begin(), lod.vertexCounter.end()), lod.vertexCounter.end());
+			lod.error = simplifier.GetError() / std::max(mesh.boundingSphere.radius, FLT_EPSILON);
+			mesh.lods.emplace_back(std::move(lod));
+		}
+	}
+	// Gribb-Hartmann, the planes are combinations of the clip space columns (row vectors, 0 <= z <= w)
+	inline Frustum ExtractFrustumPlanes(const Matrix& viewProjectionMatrix)
+	{
+		const Vector4 columnX{ viewProjectionMatrix[0].x, viewProjectionMatrix[1].x, viewProjectionMatrix[2].x, viewProjectionMatrix[3].x };
+		const Vector4 columnY{ viewProjectionMatrix[0].y, viewProjectionMatrix[1].y, viewProjectionMatrix[2].y, viewProjectionMatrix[3].y };
+		const Vector4 columnZ{ viewProjectionMatrix[0].z, viewProjectionMatrix[1].z, viewProjectionMatrix[2].z, viewProjectionMatrix[3].z };
+		const Vector4 columnW{ viewProjectionMatrix[0].w, viewProjectionMatrix[1].w, viewProjectionMatrix[2].w, viewProjectionMatrix[3].w };
+
+		Frustum frustum{ { columnW + columnX, columnW - columnX, columnW + columnY, columnW - columnY, columnZ, columnW - columnZ } };
+		for (Vector4& plane : frustum.planes)
+			plane = plane / plane.GetXYZ().Magnitude();
+		return frustum;
+	}
+	inline bool IsSphereInFrustum(const Frustum& frustum, const Vector3& center, float radius)
+	{
+		for (const Vector4& plane : frustum.planes)
+		{
+			if (Vector3::Dot(plane.GetXYZ(), center) + plane.w < -radius) return false;
+		}
+		return true;
+	}
+	inline bool IsBoxInFrustum(const Frustum& frustum, const Vector3& center, const Vector3& extents)
+	{
+		for (const Vector4& plane : frustum.planes)
+		{
+			// Distance of the box corner that is furthest along the plane normal
+			const float projectedExtent = std::abs(plane.x) * extents.x + std::abs(plane.y) * extents.y + std::abs(plane.z) * extents.z;
+			if (Vector3::Dot(plane.GetXYZ(), center) + plane.w < -projectedExtent) return false;
+		}
+		return true;
+	}
+	// World space box around a transformed object space box, its extents are the local ones through the absolute rotation/scale
+	inline BoundingBox CalculateWorldBounds(const BoundingBox& bounds, const Matrix& worldMatrix)
+	{
+		const Vector3 extents = (bounds.max - bounds.min) * 0.5f;
+		const Vector3 center = worldMatrix.TransformPoint((bounds.min + bounds.max) * 0.5f);
+		Vector3 worldExtents{};
+		for (int axis{}; axis < 3; ++axis)
+			worldExtents[axis] = std::abs(worldMatrix[0][axis]) * extents.x + std::abs(worldMatrix[1][axis]) * extents.y + std::abs(worldMatrix[2][axis]) * extents.z;
+		return { center - worldExtents, center + worldExtents };
+	}
+	// Stable LSD radix sort of the items in order by their 16-bit key, two passes of 8 bits
+	inline void RadixSortByKey(const std::vector<uint16_t>& keys, std::vector<uint32_t>& order, std::vector<uint32_t>& scratch)
+	{
+		scratch.resize(order.size());
+		for (int shift{}; shift < 16; shift += 8)
+		{
+			std::array<uint32_t, 257> offsets{};
+			for (uint32_t item : order) ++offsets[((keys[item] >> shift) & 0xFF) + 1];
+			for (size_t bucket{ 1 }; bucket < offsets.size(); ++bucket) offsets[bucket] += offsets[bucket - 1];
+			for (uint32_t item : order) scratch[offsets[(keys[item] >> shift) & 0xFF]++] = item;
+			order.swap(scratch);
+		}
+	}
+	// The same sort on the job system, every task counts and then scatters its own range of grainSize items. Within a bucket
+	// the ranges get their places in order, so it stays stable. Fewer than two ranges are sorted by the serial one
+	inline void RadixSortByKey(JobSystem& jobSystem, uint32_t grainSize, const std::vector<uint16_t>& keys, std::vector<uint32_t>& order,
+		std::vector<uint32_t>& scratch, std::vector<std::array<uint32_t, 256>>& histograms)
+	{
+		const uint32_t itemCount = uint32_t(order.size());
+		const uint32_t rangeCount = (itemCount + grainSize - 1) / grainSize;
+		if (rangeCount < 2 or jobSystem.GetThreadCount() == 1)
+		{
+			RadixSortByKey(keys, order, scratch);
+			return;
+		}
+
+		scratch.resize(itemCount);
+		histograms.resize(rangeCount);
+		for (int shift{}; shift < 16; shift += 8)
+		{
+			jobSystem.ParallelFor(rangeCount, 1, [&](uint32_t range)
+				{
+					std::array<uint32_t, 256>& histogram = histograms[range];
+					histogram.fill(0);
+					const uint32_t end = std::min((range + 1) * grainSize, itemCount);
+					for (uint32_t index{ range * grainSize }; index < end; ++index) ++histogram[(keys[order[index]] >> shift) & 0xFF];
+				});
+
+			// Bucket by bucket and range by range, the counts become the first position every range writes to in every bucket
+			uint32_t offset{};
+			for (size_t bucket{}; bucket < 256; ++bucket)
+			{
+				for (uint32_t range{}; range < rangeCount; ++range)
+				{
+					const uint32_t count = histograms[range][bucket];
+					histograms[range][bucket] = offset;
+					offset += count;
+				}
+			}
+
+			jobSystem.ParallelFor(rangeCount, 1, [&](uint32_t range)
+				{
+					std::array<uint32_t, 256>& offsets = histograms[range];
+					const uint32_t end = std::min((range + 1) * grainSize, itemCount);
+					for (uint32_t index{ range * grainSize }; index < end; ++index)
+					{
+						const uint32_t item = order[index];
+						scratch[offsets[(keys[item] >> shift) & 0xFF]++] = item;
+					}
+				});
+			order.swap(scratch);
+		}
+	}
 	inline bool TileOverlap(const Vector2& triangleMin, const Vector2& triangleMax, const Vector2& tileMin, const Vector2& tileMax)
 	{
 		return !(tileMax.x < triangleMin.x || tileMin.x > triangleMax.x ||
@@ -123,7 +390,8 @@ namespace dae
 		//Just parses vertices and indices
 #pragma warning(push)
 #pragma warning(disable : 4505) //Warning unreferenced local function
-		static bool ParseOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<uint32_t>& vertexCounter, bool flipAxisAndWinding = true)
+		static bool ParseOBJ(std::istream& file, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<uint32_t>& vertexCounter,
+			BoundingBox& bounds, BoundingSphere& boundingSphere, bool flipAxisAndWinding = true)
 		{
 #ifdef DISABLE_OBJ
 
@@ -133,10 +401,6 @@ namespace dae
 
 #else
 
-			std::ifstream file(filename);
-			if (!file)
-				return false;
-
 			std::vector<Vector3> positions{};
 			std::vector<Vector3> normals{};
 			std::vector<Vector2> UVs{};
@@ -281,9 +545,22 @@ namespace dae
 			vertexCounter.resize(vertices.size());
 			std::iota(vertexCounter.begin(), vertexCounter.end(), 0);
 
+			// After the axis flip, the bounds are in the same space as the positions
+			bounds = CalculateBoundingBox(vertices);
+			boundingSphere = CalculateBoundingSphere(bounds, vertices);
+
 			return true;
 #endif
 		}
+		static bool ParseOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<uint32_t>& vertexCounter,
+			BoundingBox& bounds, BoundingSphere& boundingSphere, bool flipAxisAndWinding = true)
+		{
+			std::ifstream file(filename);
+			if (!file)
+				return false;
+
+			return ParseOBJ(file, vertices, indices, vertexCounter, bounds, boundingSphere, flipAxisAndWinding);
+		}
 #pragma warning(pop)
 	}
 }
\ No newline at end of file
@@ -7,9 +7,16 @@
 #undef main
 
 //Standard includes
+#include <cctype>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <string>
+#include <vector>
 
 //Project includes
+#include "BenchmarkScenes.h"
+#include "Presenter.h"
 #include "Timer.h"
 #include "Renderer.h"
 
@@ -29,13 +36,91 @@ void ResetConsoleColor()
 	std::cout << "\033[0m";
 }
 
+void PrintFramePacing(const FramePacingStats& pacing)
+{
+	std::cout << ">> PRESENTED = " << pacing.frameCount << " frames, every " << pacing.averageInterval << " ms (min " << pacing.minInterval
+		<< ", max " << pacing.maxInterval << ", deviation " << pacing.intervalDeviation << ")\n";
+	std::cout << ">> PRESENT TIME = " << pacing.averagePresentTime << " ms, BUFFER WAIT = " << pacing.averageAcquireWait << " ms\n";
+}
+
+// Runs every scripted benchmark scene on a fresh renderer and prints a summary, returns false if a scene got interrupted
+bool RunBenchmarkScenes(SDL_Window* pWindow, Timer* pTimer, int framesPerScene)
+{
+	std::vector<std::pair<std::string, float>> results{};
+	for (const BenchmarkScene& scene : GetBenchmarkScenes())
+	{
+		std::cout << "===== Scene: " << scene.name << " =====\n";
+
+		Renderer renderer{ pWindow, scene.sceneFile.empty() ? Renderer::DefaultSceneFile : scene.sceneFile };
+		scene.setup(renderer);
+
+		pTimer->Start();
+		pTimer->StartBenchmark(framesPerScene);
+		while (pTimer->IsBenchmarkRunning())
+		{
+			SDL_Event e;
+			while (SDL_PollEvent(&e))
+			{
+				if (e.type == SDL_QUIT) return false;
+			}
+
+			renderer.Update(pTimer);
+			renderer.Render();
+			pTimer->Update();
+		}
+		pTimer->Stop();
+		PrintFramePacing(renderer.GetFramePacingStats());
+
+		results.emplace_back(scene.name, pTimer->GetBenchmarkAverage());
+	}
+
+	// Summary, parsed by cmake/PGOWorkflow.cmake
+	float total{};
+	std::cout << "===== Benchmark Scenes =====\n" << std::fixed << std::setprecision(3);
+	for (const auto& [name, averageMs] : results)
+	{
+		std::cout << "SCENE " << name << " " << averageMs << " ms\n";
+		total += averageMs;
+	}
+	std::cout << "SCENE Total " << total << " ms\n" << std::defaultfloat;
+	return true;
+}
+
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	//Command line
+	// --benchmark [frames]	Render a fixed number of frames in a hidden window, print the timings and quit
+	// --scenes [frames]	Same, but for every scripted benchmark scene (see BenchmarkScenes.cpp)
+	// --headless			Render without a video device, e.g. on build machines
+	// --scene <file>		Scene file to render instead of the default one (see SceneFile.h)
+	bool benchmarkMode = false;
+	bool sceneMode = false;
+	bool headless = false;
+	int benchmarkFrames = 500;
+	std::string sceneFile = Renderer::DefaultSceneFile;
+	for (int argIndex{ 1 }; argIndex < argc; ++argIndex)
+	{
+		const bool isBenchmark = std::strcmp(args[argIndex], "--benchmark") == 0;
+		const bool isScenes = std::strcmp(args[argIndex], "--scenes") == 0;
+		if (isBenchmark or isScenes)
+		{
+			benchmarkMode = true;
+			sceneMode = sceneMode or isScenes;
+			if (argIndex + 1 < argc and std::isdigit(static_cast<unsigned char>(args[argIndex + 1][0])))
+				benchmarkFrames = std::stoi(args[++argIndex]);
+		}
+		else if (std::strcmp(args[argIndex], "--headless") == 0)
+		{
+			headless = true;
+		}
+		else if (std::strcmp(args[argIndex], "--scene") == 0 and argIndex + 1 < argc)
+		{
+			sceneFile = args[++argIndex];
+		}
+	}
 
 	//Create window + surfaces
+	if (headless) SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
 	SDL_Init(SDL_INIT_VIDEO);
 
 	const uint32_t width = 640;
@@ -45,29 +130,43 @@ int main(int argc, char* args[])
 		"Rasterizer - **Dereyne Kobe - (2DAE10)**",
 		SDL_WINDOWPOS_UNDEFINED,
 		SDL_WINDOWPOS_UNDEFINED,
-		width, height, 0);
+		width, height, benchmarkMode ? SDL_WINDOW_HIDDEN : 0);
 
 	if (!pWindow)
 		return 1;
 
+	if (sceneMode)
+	{
+		Timer timer{};
+		const bool completed = RunBenchmarkScenes(pWindow, &timer, benchmarkFrames);
+		ShutDown(pWindow);
+		return completed ? 0 : 1;
+	}
+
 	//Initialize "framework"
 	const auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
+	const auto pRenderer = new Renderer(pWindow, sceneFile);
 
 	//Start loop
 	pTimer->Start();
 
 	// Start Benchmark
-	// TODO pTimer->StartBenchmark();
+	if (benchmarkMode) pTimer->StartBenchmark(benchmarkFrames);
 
 	SetConsoleColor(33);
 	std::cout << "===== Shortcuts =====\n";
 	std::cout << "F1 - Toggle FPS in Console [OFF/ON]\n";
+	std::cout << "F2 - Toggle HDR Tonemapping [OFF/ON]\n";
+	std::cout << "F3 - Toggle Frame Pipelining [ON/OFF]\n";
 	std::cout << "F4 - Toggle Depth Buffer Visualization [OFF/ON]\n";
 	std::cout << "F5 - Toggle Rotation [ON/OFF]\n";
 	std::cout << "F6 - Toggle Normal Map [ON/OFF]\n";
 	std::cout << "F7 - Cycle Shading Mode [Combined - Observed Area - Diffuse - Specular]\n";
-	std::cout << "F8 - Toggle Wireframes [OFF/ON]\n\n";
+	std::cout << "F8 - Toggle Wireframes [OFF/ON]\n";
+	std::cout << "F9 - Cycle Render Path [Forward - Deferred - Visibility Buffer - Depth Pre-Pass]\n";
+	std::cout << "F10 - Toggle Front To Back Sorting [OFF/ON]\n";
+	std::cout << "F11 - Toggle Hi-Z Occlusion Rejection [ON/OFF]\n";
+	std::cout << "F12 - Toggle Mesh Occlusion Culling [ON/OFF]\n\n";
 	ResetConsoleColor();
 
 	bool displayFPS = false;
@@ -90,6 +189,10 @@ int main(int argc, char* args[])
 					takeScreenshot = true;
 				if (e.key.keysym.scancode == SDL_SCANCODE_F1)
 					displayFPS = !displayFPS;
+				if (e.key.keysym.scancode == SDL_SCANCODE_F2)
+					pRenderer->ToggleHdr();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
+					pRenderer->TogglePipelinedFrames();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F4)
 					pRenderer->ToggleDepthBufferVisualization();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F5)
@@ -100,6 +203,14 @@ int main(int argc, char* args[])
 					pRenderer->CycleShadingMode();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
 					pRenderer->ToggleWireFrames();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+					pRenderer->CycleRenderPath();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+					pRenderer->ToggleDepthSorting();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+					pRenderer->ToggleHiZ();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F12)
+					pRenderer->ToggleOcclusionCulling();
 				break;
 			}
 		}
@@ -112,6 +223,8 @@ int main(int argc, char* args[])
 
 		//--------- Timer ---------
 		pTimer->Update();
+		if (benchmarkMode and !pTimer->IsBenchmarkRunning())
+			isLooping = false;
 		if(displayFPS)
 		{
 			printTimer += pTimer->GetElapsed();
@@ -119,6 +232,8 @@ int main(int argc, char* args[])
 			{
 				printTimer = 0.f;
 				std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+				PrintFramePacing(pRenderer->GetFramePacingStats());
+				pRenderer->ResetFramePacingStats();
 			}
 		}
 
@@ -133,6 +248,7 @@ int main(int argc, char* args[])
 		}
 	}
 	pTimer->Stop();
+	if (benchmarkMode) PrintFramePacing(pRenderer->GetFramePacingStats());
 
 	//Shutdown "framework"
 	delete pRenderer;